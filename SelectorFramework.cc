@@ -4,13 +4,30 @@
 // because then we can just glob all the source files instead of listing them
 // individually.
 
+#include "core/AlgProfiler.cc"
 #include "core/BaseIO.cc"
+#include "core/ChainIndex.cc"
+#include "core/Checkpoint.cc"
 #include "core/Clock.cc"
 #include "core/ConfigTool.cc"
+#include "core/EntryList.cc"
 #include "core/EventBuf.cc"
+#include "core/Fanout.cc"
+#include "core/FilePool.cc"
+#include "core/FilePrefetcher.cc"
+#include "core/FlatFile.cc"
+#include "core/IOStats.cc"
+#include "core/InputCheck.cc"
 #include "core/Kernel.cc"
+#include "core/Progress.cc"
+#include "core/Results.cc"
 #include "core/SimpleAlg.cc"
+#include "core/SkimCache.cc"
+#include "core/Sweep.cc"
 #include "core/SyncReader.cc"
+#include "core/TimeHist.cc"
 #include "core/TimeSyncReader.cc"
 #include "core/TreeWriter.cc"
 #include "core/Util.cc"
+#include "core/VetoIndex.cc"
+#include "core/WorkQueue.cc"
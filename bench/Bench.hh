@@ -0,0 +1,85 @@
+#pragma once
+
+// Minimal timing harness shared by the benchmarks in this directory. Results
+// are printed as a table and optionally saved as JSON for compare.py.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+struct Result {
+  std::string name;
+  size_t ops;
+  double nsPerOp;
+  double extra = 0;             // benchmark-specific (e.g. events/s, RSS)
+  std::string extraName;
+};
+
+// Keep the compiler from optimizing away a computed value
+template <class T>
+inline void keep(const T& val)
+{
+  asm volatile("" : : "g"(&val) : "memory");
+}
+
+// Runs f() (which performs `ops` operations) `reps` times after one warm-up
+// run, and reports the fastest repetition
+template <class F>
+Result run(const char* name, size_t ops, F f, int reps = 5)
+{
+  using Clock = std::chrono::steady_clock;
+
+  f();
+  double best = 1e300;
+
+  for (int i = 0; i < reps; ++i) {
+    const auto t0 = Clock::now();
+    f();
+    const auto t1 = Clock::now();
+    best = std::min(best, std::chrono::duration<double, std::nano>(t1 - t0).count());
+  }
+
+  return {name, ops, best / ops};
+}
+
+inline void print(const std::vector<Result>& results)
+{
+  printf("%-40s %14s %12s\n", "benchmark", "ops", "ns/op");
+  for (const auto& r : results) {
+    printf("%-40s %14zu %12.3f", r.name.c_str(), r.ops, r.nsPerOp);
+    if (!r.extraName.empty())
+      printf("   %s = %.4g", r.extraName.c_str(), r.extra);
+    printf("\n");
+  }
+}
+
+inline void saveJson(const std::vector<Result>& results, const char* path)
+{
+  std::ofstream ofs(path);
+  ofs << "{\n  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto& r = results[i];
+    ofs << "    {\"name\": \"" << r.name << "\", \"ops\": " << r.ops
+        << ", \"ns_per_op\": " << r.nsPerOp;
+    if (!r.extraName.empty())
+      ofs << ", \"" << r.extraName << "\": " << r.extra;
+    ofs << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  ofs << "  ]\n}\n";
+}
+
+// Handles the common "--json out.json" argument; returns the path or nullptr
+inline const char* jsonArg(int argc, char** argv)
+{
+  for (int i = 1; i + 1 < argc; ++i)
+    if (std::string(argv[i]) == "--json")
+      return argv[i + 1];
+  return nullptr;
+}
+
+} // namespace bench
@@ -0,0 +1,310 @@
+// Micro-benchmarks for the core data structures and the event loop.
+//
+//   make -C bench && bench/_build/bench_core --json new.json
+//   bench/compare.py baseline.json new.json
+//
+// See also bench_e2e.cc for whole-job throughput on synthetic inputs.
+
+#include "Bench.hh"
+
+#include "../core/Coincidence.hh"
+#include "../core/ConfigTool.hh"
+#include "../core/EventBuf.hh"
+#include "../core/Kernel.hh"
+#include "../core/RingBuf.hh"
+#include "../core/TimeHist.hh"
+#include "../core/Util.hh"
+
+#include <TH1F.h>
+
+#include <cstdio>
+#include <unistd.h>
+
+using Status = Algorithm::Status;
+
+struct Event {
+  unsigned t;
+  float energy;
+};
+
+// Produces n events and then signals EndOfFile
+class FakeReader : public Algorithm {
+public:
+  FakeReader(size_t n) : n_(n) {}
+
+  Status execute() override
+  {
+    if (i_ == n_)
+      return Status::EndOfFile;
+    data_ = {unsigned(i_++), 1.f};
+    return Status::Continue;
+  }
+
+  bool isReader() const override { return true; }
+  bool ready() const { return true; }
+  const Event& getData() const { return data_; }
+
+private:
+  size_t n_, i_ = 0;
+  Event data_;
+};
+
+class NoopAlg : public Algorithm {
+public:
+  Status execute() override { return Status::Continue; }
+};
+
+class BenchBuf : public EventBuf<FakeReader> {
+public:
+  bool enough() const override { return true; }
+};
+
+// -----------------------------------------------------------------------------
+
+static bench::Result benchRingPut()
+{
+  constexpr size_t N = 10'000'000;
+  RingBuf<Time> ring(1000);
+  return bench::run("RingBuf<Time>::put", N, [&] {
+    for (size_t i = 0; i < N; ++i)
+      ring.put(Time(i, i));
+    bench::keep(ring.top());
+  });
+}
+
+static bench::Result benchRingInsert()
+{
+  constexpr size_t N = 1'000'000;
+  RingBuf<Time> ring(1000);
+  for (size_t i = 0; i < 1000; ++i)
+    ring.put(Time(i, 0));
+
+  return bench::run("RingBuf<Time>::insert(depth 10)", N, [&] {
+    for (size_t i = 0; i < N; ++i)
+      ring.insert(10, Time(i, 0));
+    bench::keep(ring.top());
+  });
+}
+
+static bench::Result benchRingIterate()
+{
+  constexpr size_t REPS = 10'000;
+  RingBuf<Time> ring(1000);
+  for (size_t i = 0; i < 1500; ++i)
+    ring.put(Time(i, 0));
+
+  return bench::run("RingBuf<Time> iteration (per item)", REPS * ring.size(), [&] {
+    int64_t sum = 0;
+    for (size_t r = 0; r < REPS; ++r)
+      for (const auto& t : ring)
+        sum += t.nanos;
+    bench::keep(sum);
+  });
+}
+
+static bench::Result benchEventBuf()
+{
+  constexpr size_t N = 10'000'000;
+  BenchBuf buf;
+  buf.resize(1000);
+
+  return bench::run("EventBuf consume+release", N, [&] {
+    for (size_t i = 0; i < N; ++i) {
+      buf.consume(Event{unsigned(i), 1.f});
+      bench::keep(buf.getData());
+      buf.postExecute();
+    }
+  });
+}
+
+static bench::Result benchLoop(size_t nAlgs)
+{
+  constexpr size_t N = 2'000'000;
+
+  auto result = bench::run("", N * nAlgs, [&] {
+    Pipeline p;
+    p.makeAlg<FakeReader>(N);
+    for (size_t i = 0; i < nAlgs; ++i)
+      p.makeAlg<NoopAlg>();
+    p.process({});
+  }, 3);
+
+  result.name = "Pipeline::loop per alg (" + std::to_string(nAlgs) + " algs)";
+  return result;
+}
+
+static bench::Result benchDiffUs()
+{
+  constexpr size_t N = 1000;
+  constexpr size_t REPS = 10'000;
+  std::vector<Time> times;
+  for (size_t i = 0; i < N; ++i)
+    times.emplace_back(1000 + i / 3, (i * 7919) % 1'000'000'000);
+  const Time ref(1500, 123);
+
+  return bench::run("Time::diff_us", N * REPS, [&] {
+    double sum = 0;
+    for (size_t r = 0; r < REPS; ++r)
+      for (const auto& t : times)
+        sum += ref.diff_us(t);
+    bench::keep(sum);
+  });
+}
+
+// One delayed candidate vs. a full buffer of muons, as in SinglesVsMuonsAlg
+static RingBuf<Time> muonRing()
+{
+  RingBuf<Time> ring(1000);
+  for (size_t i = 0; i < 1500; ++i)
+    ring.put(Time(1000 + i / 1000, (i % 1000) * 1'000'000));
+  return ring;
+}
+
+static bench::Result benchFillScalar()
+{
+  constexpr size_t REPS = 1000;
+  const auto ring = muonRing();
+  const Time t(1001, 600'000'000);
+  TH1F h("hScalar", "", 200, 0, 2000);
+
+  return bench::run("TH1F::Fill(diff_us) per muon", REPS * ring.size(), [&] {
+    for (size_t r = 0; r < REPS; ++r)
+      for (const auto& muonTime : ring)
+        h.Fill(t.diff_us(muonTime));
+  });
+}
+
+static bench::Result benchFillKernel()
+{
+  constexpr size_t REPS = 1000;
+  const auto ring = muonRing();
+  const Time t(1001, 600'000'000);
+  TH1F h("hKernel", "", 200, 0, 2000);
+
+  return bench::run("fillTimeDiffs per muon", REPS * ring.size(), [&] {
+    for (size_t r = 0; r < REPS; ++r)
+      fillTimeDiffs(h, t, ring);
+  });
+}
+
+// A time-ordered singles-like stream over 4 detectors
+struct Single {
+  Time t;
+  unsigned det;
+  float energy;
+};
+
+static std::vector<Single> singlesStream(size_t n)
+{
+  std::vector<Single> events;
+  events.reserve(n);
+  int64_t nanos = 1'000'000'000'000'000'000;
+  uint64_t rng = 12345;
+  for (size_t i = 0; i < n; ++i) {
+    rng = rng * 6364136223846793005 + 1442695040888963407;
+    nanos += (rng >> 40) % 100'000;                     // ~20 kHz overall
+    const float energy = 0.5f + 12.f * ((rng >> 20) % 1000) / 1000.f;
+    events.push_back({Time::fromNanos(nanos), unsigned(rng >> 62), energy});
+  }
+  return events;
+}
+
+static constexpr float ISOLATION_US = 200;
+
+// The hand-written per-detector isolation logic of SinglesVsMuonsAlg
+static bench::Result benchIsolationSample()
+{
+  const auto events = singlesStream(1'000'000);
+
+  return bench::run("SinglesVsMuons isolation logic per event", events.size(), [&] {
+    Time lastPmpTime[4], lastDlyTime[4];
+    bool gapToDlyBeforeLastDly[4]{}, gapToPmpBeforeLastDly[4]{};
+    size_t nTight = 0;
+
+    for (const auto& e : events) {
+      const bool isPmp = e.energy > 0.7 && e.energy < 12;
+      const bool isDly = e.energy > 6 && e.energy < 12;
+      if (isDly) {
+        const bool gapToDly = e.t.diff_us(lastDlyTime[e.det]) > ISOLATION_US;
+        const bool gapToPmp = e.t.diff_us(lastPmpTime[e.det]) > ISOLATION_US;
+        nTight += gapToDly && gapToPmpBeforeLastDly[e.det];
+        lastDlyTime[e.det] = e.t;
+        gapToDlyBeforeLastDly[e.det] = gapToDly;
+        gapToPmpBeforeLastDly[e.det] = gapToPmp;
+      }
+      if (isPmp)
+        lastPmpTime[e.det] = e.t;
+    }
+    bench::keep(nTight);
+  });
+}
+
+static bench::Result benchCoincidence()
+{
+  const auto events = singlesStream(1'000'000);
+  const CoincidenceWindow window{1, ISOLATION_US, ISOLATION_US, ISOLATION_US};
+
+  return bench::run("CoincidenceFinder per event", events.size(), [&] {
+    size_t nPairs = 0;
+    auto emit = [&](const Single&, const Single&) { ++nPairs; };
+    std::vector<CoincidenceFinder<Single>> finders;
+    for (int det = 0; det < 4; ++det)
+      finders.emplace_back(window, emit);
+
+    for (const auto& e : events) {
+      const bool isPmp = e.energy > 0.7 && e.energy < 12;
+      const bool isDly = e.energy > 6 && e.energy < 12;
+      if (isPmp || isDly)
+        finders[e.det].add(e.t, e, isPmp, isDly);
+    }
+    for (auto& finder : finders)
+      finder.flush();
+    bench::keep(nPairs);
+  });
+}
+
+static bench::Result benchConfigGet()
+{
+  constexpr size_t N = 1'000'000;
+
+  char path[] = "/tmp/bench_config_XXXXXX";
+  const int fd = mkstemp(path);
+  FILE* f = fdopen(fd, "w");
+  for (int i = 0; i < 50; ++i)
+    fprintf(f, "INT_KEY_%d %d\nFLOAT_KEY_%d %d.5\n", i, i, i, i);
+  fprintf(f, "ISOLATION_US 200\n");
+  fclose(f);
+
+  Config config(path);
+  unlink(path);
+
+  return bench::run("Config::get<int>", N, [&] {
+    int sum = 0;
+    for (size_t i = 0; i < N; ++i)
+      sum += config.get<int>("ISOLATION_US");
+    bench::keep(sum);
+  });
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<bench::Result> results = {
+    benchRingPut(),
+    benchRingInsert(),
+    benchRingIterate(),
+    benchEventBuf(),
+    benchLoop(1),
+    benchLoop(10),
+    benchDiffUs(),
+    benchFillScalar(),
+    benchFillKernel(),
+    benchIsolationSample(),
+    benchCoincidence(),
+    benchConfigGet(),
+  };
+
+  bench::print(results);
+
+  if (const char* json = bench::jsonArg(argc, argv))
+    bench::saveJson(results, json);
+}
@@ -0,0 +1,74 @@
+// End-to-end throughput of the SinglesVsMuons sample, e.g. on gen_synth output:
+//
+//   _build/gen_synth --out-dir /tmp/synth --files 4 | _build/bench_e2e - --json e2e.json
+
+#include "Bench.hh"
+
+#include "../samples/SinglesVsMuons.cc"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <iostream>
+
+static size_t nEvents = 0;
+
+Status countEvent(const SingData&)
+{
+  ++nEvents;
+  return Status::Continue;
+}
+
+using CountAlg = PureAlg<SingReader, countEvent>;
+
+// Same pipeline as run(), plus an event counter right after the reader
+static void runCounted(const std::vector<std::string>& files)
+{
+  Pipeline p;
+
+  p.makeOutFile("bench_e2e_results.root", "resultsFile");
+
+  p.makeAlg<SingReader>();
+  p.makeAlg<CountAlg>();
+  p.makeAlg<CrossTriggerAlg>();
+  p.makeAlg<MuonAlg>();
+  p.makeAlg<FlasherAlg>();
+
+  p.makeAlg<SinglesVsMuonsAlg>("resultsFile");
+
+  p.process(files);
+}
+
+static double peakRssMB()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss / 1024.;  // Linux reports kB
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    std::cerr << "Usage: bench_e2e <file.root | -> [--json out.json]" << std::endl;
+    return 1;
+  }
+
+  const auto files = util::parse_infile_arg(argv[1]);
+
+  const auto t0 = std::chrono::steady_clock::now();
+  runCounted(files);
+  const auto t1 = std::chrono::steady_clock::now();
+
+  const double secs = std::chrono::duration<double>(t1 - t0).count();
+
+  const std::vector<bench::Result> results = {
+    {"SinglesVsMuons end-to-end (per event)", nEvents, secs * 1e9 / nEvents,
+     peakRssMB(), "peak_rss_mb"}
+  };
+
+  bench::print(results);
+  printf("%.4g events/s\n", nEvents / secs);
+
+  if (const char* json = bench::jsonArg(argc, argv))
+    bench::saveJson(results, json);
+}
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+
+"""Compare two benchmark JSON files (from --json) and flag regressions.
+
+Usage: compare.py baseline.json current.json [--threshold 0.10]
+
+Exits with status 1 if any benchmark got slower by more than the threshold.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {b['name']: b for b in json.load(f)['benchmarks']}
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('baseline')
+    ap.add_argument('current')
+    ap.add_argument('--threshold', type=float, default=0.10,
+                    help='allowed fractional slowdown (default 0.10)')
+    args = ap.parse_args()
+
+    base = load(args.baseline)
+    cur = load(args.current)
+
+    regressions = 0
+    print(f'{"benchmark":40} {"base ns/op":>12} {"cur ns/op":>12} {"change":>9}')
+
+    for name, b in base.items():
+        if name not in cur:
+            print(f'{name:40} {b["ns_per_op"]:12.3f} {"missing":>12}')
+            continue
+
+        old, new = b['ns_per_op'], cur[name]['ns_per_op']
+        change = new / old - 1 if old > 0 else 0
+        flag = ''
+        if change > args.threshold:
+            flag = '  REGRESSION'
+            regressions += 1
+        print(f'{name:40} {old:12.3f} {new:12.3f} {100*change:+8.1f}%{flag}')
+
+    for name in cur.keys() - base.keys():
+        print(f'{name:40} {"new":>12} {cur[name]["ns_per_op"]:12.3f}')
+
+    if regressions:
+        print(f'\n{regressions} regression(s) beyond {100*args.threshold:.0f}%')
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,216 @@
+// Writes synthetic Daya Bay-like input files with the /Event/Rec/AdSimple and
+// /Event/Data/CalibStats trees that SingReader expects, so that the samples
+// can be benchmarked without access to the real data.
+//
+//   gen_synth [--out-dir DIR] [--files N] [--events N] [--dets 1,2,5,6]
+//             [--singles-hz X] [--muon-hz X] [--neutron-yield X] [--seed N]
+//
+// --events is per file and --singles-hz/--muon-hz are per detector. Muons in
+// ADs (1-4) are followed by --neutron-yield delayed-like triggers on average.
+
+#include "../core/BaseIO.hh"
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct AdSimpleData : public TreeBase {
+  Short_t detector;
+  UInt_t triggerType, triggerTimeSec, triggerTimeNanoSec;
+  Float_t energy;
+
+  void initBranches() override
+  {
+    BR(detector);
+    BR(triggerType); BR(triggerTimeSec); BR(triggerTimeNanoSec);
+    BR(energy);
+  }
+};
+
+struct CalibStatsData : public TreeBase {
+  Int_t nHit;
+  Float_t NominalCharge;
+  Float_t Quadrant, MaxQ, MaxQ_2inchPMT, time_PSD, time_PSD1;
+
+  void initBranches() override
+  {
+    BR(nHit); BR(NominalCharge);
+    BR(Quadrant); BR(MaxQ); BR(MaxQ_2inchPMT); BR(time_PSD); BR(time_PSD1);
+  }
+};
+
+struct Params {
+  std::string outDir = ".";
+  size_t nFiles = 2;
+  size_t eventsPerFile = 1'000'000;
+  std::vector<int> dets = {1, 2, 5, 6};
+  double singlesHz = 20;
+  double muonHz = 200;
+  double neutronYield = 0.05;
+  unsigned seed = 42;
+};
+
+static bool isAD(int det) { return det >= 1 && det <= 4; }
+
+class Generator {
+public:
+  Generator(const Params& pars) : pars(pars), rng(pars.seed) {}
+  void writeFile(const std::string& path);
+
+private:
+  struct Trigger {
+    double t;                   // seconds
+    int det;
+    enum { Single, Muon, Neutron } kind;
+
+    bool operator>(const Trigger& other) const { return t > other.t; }
+  };
+
+  Trigger next();
+  void fill(const Trigger& trig);
+
+  Params pars;
+  std::mt19937_64 rng;
+  std::uniform_real_distribution<double> uniform{0, 1};
+
+  double now = 1.3e9;           // roughly 2011
+  // earliest on top
+  std::priority_queue<Trigger, std::vector<Trigger>, std::greater<Trigger>> pendingNeutrons;
+
+  AdSimpleData rec;
+  CalibStatsData calib;
+};
+
+Generator::Trigger Generator::next()
+{
+  const double rate = pars.dets.size() * (pars.singlesHz + pars.muonHz);
+  now += std::exponential_distribution<double>(rate)(rng);
+
+  // Neutrons are emitted out of order, so release the earliest if it's now
+  // due (one per call, so the next call still sees any others in time order)
+  if (!pendingNeutrons.empty() && pendingNeutrons.top().t <= now) {
+    const auto trig = pendingNeutrons.top();
+    pendingNeutrons.pop();
+    now = trig.t;
+    return trig;
+  }
+
+  const int det = pars.dets[rng() % pars.dets.size()];
+  const bool muon = uniform(rng) < pars.muonHz / (pars.singlesHz + pars.muonHz);
+
+  if (muon && isAD(det) && uniform(rng) < pars.neutronYield) {
+    const double dt = std::exponential_distribution<double>(1 / 200e-6)(rng);
+    pendingNeutrons.push({now + dt, det, Trigger::Neutron});
+  }
+
+  return {now, det, muon ? Trigger::Muon : Trigger::Single};
+}
+
+void Generator::fill(const Trigger& trig)
+{
+  rec.detector = trig.det;
+  rec.triggerTimeSec = UInt_t(trig.t);
+  rec.triggerTimeNanoSec = UInt_t((trig.t - rec.triggerTimeSec) * 1e9);
+  // a small fraction of cross triggers, which CrossTriggerAlg vetoes
+  rec.triggerType = uniform(rng) < 0.01 ? 0x10000002 : 0x10001100;
+
+  calib.Quadrant = 0.3 * uniform(rng);
+  calib.MaxQ = 0.2 * uniform(rng);
+  calib.MaxQ_2inchPMT = 10 * uniform(rng);
+  calib.time_PSD = 0.9 + 0.1 * uniform(rng);
+  calib.time_PSD1 = 0.9 + 0.1 * uniform(rng);
+  // ~0.5% flashers
+  if (uniform(rng) < 0.005)
+    calib.Quadrant = 1.5;
+
+  const bool muon = trig.kind == Trigger::Muon;
+
+  if (isAD(trig.det)) {
+    rec.energy = muon ? 20 + 200 * uniform(rng)
+      : trig.kind == Trigger::Neutron ? 6 + 4 * uniform(rng)
+      : 0.7 + std::exponential_distribution<double>(1.5)(rng);
+    calib.NominalCharge = muon ? 3000 + 1e5 * uniform(rng) : 170 * rec.energy;
+    calib.nHit = 192;
+  } else {                      // water pool
+    rec.energy = 0;
+    calib.NominalCharge = 0;
+    calib.nHit = muon ? 13 + rng() % 100 : rng() % 12;
+  }
+}
+
+void Generator::writeFile(const std::string& path)
+{
+  TFile f(path.c_str(), "RECREATE");
+
+  auto makeTree = [&](const char* dir, const char* name, TreeBase& data,
+                      BranchManager& mgr) {
+    f.mkdir(dir, "", true)->cd();
+    mgr.tree = new TTree(name, name);
+    data.setManager(&mgr);
+    data.initBranches();
+    return mgr.tree;
+  };
+
+  BranchManager recMgr(BranchManager::IOMode::OUT);
+  BranchManager calibMgr(BranchManager::IOMode::OUT);
+  TTree* recTree = makeTree("Event/Rec", "AdSimple", rec, recMgr);
+  TTree* calibTree = makeTree("Event/Data", "CalibStats", calib, calibMgr);
+
+  for (size_t i = 0; i < pars.eventsPerFile; ++i) {
+    fill(next());
+    recTree->Fill();
+    calibTree->Fill();
+  }
+
+  f.Write();
+  f.Close();
+}
+
+static std::vector<int> parseDets(const std::string& arg)
+{
+  std::vector<int> dets;
+  std::stringstream ss(arg);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    dets.push_back(std::stoi(item));
+  return dets;
+}
+
+int main(int argc, char** argv)
+{
+  Params pars;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string key = argv[i], val = argv[i + 1];
+    if (key == "--out-dir") pars.outDir = val;
+    else if (key == "--files") pars.nFiles = std::stoul(val);
+    else if (key == "--events") pars.eventsPerFile = std::stoul(val);
+    else if (key == "--dets") pars.dets = parseDets(val);
+    else if (key == "--singles-hz") pars.singlesHz = std::stod(val);
+    else if (key == "--muon-hz") pars.muonHz = std::stod(val);
+    else if (key == "--neutron-yield") pars.neutronYield = std::stod(val);
+    else if (key == "--seed") pars.seed = std::stoul(val);
+    else {
+      std::cerr << "Unknown option " << key << std::endl;
+      return 1;
+    }
+  }
+
+  Generator gen(pars);
+
+  for (size_t i = 0; i < pars.nFiles; ++i) {
+    char name[64];
+    snprintf(name, sizeof name, "/synth.%04zu.root", i + 1);
+    const std::string path = pars.outDir + name;
+    gen.writeFile(path);
+    std::cout << path << std::endl; // so the output can be piped into a job
+  }
+}
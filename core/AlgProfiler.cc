@@ -0,0 +1,193 @@
+#include "AlgProfiler.hh"
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+static constexpr double NA = std::numeric_limits<double>::quiet_NaN();
+
+#ifdef __linux__
+static int openCounter(uint64_t config, int groupFd)
+{
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof attr);
+  attr.size = sizeof attr;
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = groupFd < 0;  // the whole group starts with the leader
+  attr.exclude_kernel = 1;      // allowed at perf_event_paranoid = 2
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP |
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+AlgProfiler::AlgProfiler(size_t nAlgs) :
+  totals_(nAlgs)
+{
+#ifdef __linux__
+  static const uint64_t CONFIGS[N_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+  };
+
+  for (int c = 0; c < N_COUNTERS; ++c) {
+    const int fd = openCounter(CONFIGS[c], leader_);
+    if (fd < 0) {
+      if (c == Cycles) {        // no leader, no group
+        whyNot_ = strerror(errno);
+        return;
+      }
+      continue;                 // e.g. not supported by this CPU/VM
+    }
+
+    if (leader_ < 0)
+      leader_ = fd;
+    else
+      members_.push_back(fd);
+    slots_.push_back(Counter(c));
+    available_[c] = true;
+  }
+
+  ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+  whyNot_ = "not on Linux";
+#endif
+}
+
+AlgProfiler::~AlgProfiler()
+{
+  for (const int fd : members_)
+    close(fd);
+  if (leader_ >= 0)
+    close(leader_);
+}
+
+// The group is scheduled as a whole, so one enabled/running pair covers all
+// of its members
+bool AlgProfiler::readCounters(Reading& r) const
+{
+  uint64_t buf[3 + N_COUNTERS];   // nr, enabled, running, then one per member
+  const ssize_t want = sizeof(uint64_t) * (3 + slots_.size());
+  if (read(leader_, buf, sizeof buf) < want)
+    return false;
+
+  r.enabledNs = buf[1];
+  r.runningNs = buf[2];
+  for (size_t k = 0; k < slots_.size(); ++k)
+    r.counts[slots_[k]] = buf[3 + k];
+  return true;
+}
+
+void AlgProfiler::start()
+{
+  if (leader_ >= 0)
+    readCounters(start_);
+  startTime_ = Clock::now();
+}
+
+void AlgProfiler::stop(size_t iAlg)
+{
+  const auto stopTime = Clock::now();
+  Totals& t = totals_[iAlg];
+
+  Reading now;
+  if (leader_ >= 0 && readCounters(now)) {
+    t.enabledNs += now.enabledNs - start_.enabledNs;
+    t.runningNs += now.runningNs - start_.runningNs;
+    for (const Counter c : slots_)
+      t.counts[c] += now.counts[c] - start_.counts[c];
+  }
+
+  const std::chrono::duration<double> dt = stopTime - startTime_;
+  t.seconds += dt.count();
+  ++t.calls;
+}
+
+double AlgProfiler::Totals::count(Counter c) const
+{
+  if (runningNs == 0)
+    return NA;
+  return double(counts[c]) * enabledNs / runningNs;
+}
+
+bool AlgProfiler::hasCounters() const
+{
+  if (leader_ < 0)
+    return false;
+  for (const Totals& t : totals_)
+    if (t.runningNs > 0)
+      return true;
+  return false;
+}
+
+std::string AlgProfiler::whyNoCounters() const
+{
+  if (leader_ < 0)
+    return whyNot_;
+  if (!hasCounters())
+    return "the counters never got scheduled (PMU busy, e.g. another perf user"
+      " or the NMI watchdog)";
+  return "";
+}
+
+void AlgProfiler::report(std::ostream& os, const std::vector<std::string>& algNames) const
+{
+  char line[512];
+  const bool counters = hasCounters();
+
+  if (counters) {
+    uint64_t enabled = 0, running = 0;
+    for (const Totals& t : totals_) {
+      enabled += t.enabledNs;
+      running += t.runningNs;
+    }
+    if (running < enabled) {
+      snprintf(line, sizeof line, "(counters multiplexed: ran %.0f%% of the time;"
+               " counts are scaled estimates)\n", 100. * running / enabled);
+      os << line;
+    }
+    snprintf(line, sizeof line, "%-40s %12s %10s %10s %6s %12s %12s\n", "Algorithm",
+             "calls", "ns/call", "cyc/call", "IPC", "cmiss/call", "bmiss/call");
+  } else {
+    snprintf(line, sizeof line, "(no hardware counters: %s)\n%-40s %12s %10s %8s\n",
+             whyNoCounters().c_str(), "Algorithm", "calls", "ns/call", "total s");
+  }
+  os << line;
+
+  for (size_t i = 0; i < totals_.size(); ++i) {
+    const Totals& t = totals_[i];
+    const double calls = t.calls ? t.calls : 1;
+    const char* name = i < algNames.size() ? algNames[i].c_str() : "?";
+
+    auto perCall = [&](Counter c) {
+      return available_[c] ? t.count(c) / calls : NA;
+    };
+
+    if (counters) {
+      const double ipc = available_[Instructions] && t.counts[Cycles] ?
+        double(t.counts[Instructions]) / t.counts[Cycles] : NA;
+      snprintf(line, sizeof line, "%-40.40s %12zu %10.1f %10.0f %6.2f %12.3f %12.3f\n",
+               name, t.calls, 1e9 * t.seconds / calls, perCall(Cycles), ipc,
+               perCall(CacheMisses), perCall(BranchMisses));
+    } else {
+      snprintf(line, sizeof line, "%-40.40s %12zu %10.1f %8.2f\n",
+               name, t.calls, 1e9 * t.seconds / calls, t.seconds);
+    }
+    os << line;
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-algorithm cost of execute(). Where the kernel allows it (Linux
+// perf_event_open; see /proc/sys/kernel/perf_event_paranoid), this counts
+// cycles, instructions, cache misses and branch misses in user space, on the
+// loop's thread; otherwise, and always for `seconds`, it uses the wall clock.
+// Reading the counters costs a syscall per start()/stop(), so cheap
+// algorithms will look a bit more expensive than they are.
+//
+// When the PMU can't fit the group all the time (another perf user, the NMI
+// watchdog holding a counter, a VM with few counters), the kernel multiplexes
+// it: counts are then scaled up by the time enabled over the time running,
+// and the report says so. If the group never ran, the report falls back to
+// the wall clock.
+class AlgProfiler {
+public:
+  enum Counter { Cycles, Instructions, CacheMisses, BranchMisses, N_COUNTERS };
+
+  struct Totals {
+    size_t calls = 0;
+    double seconds = 0;
+    uint64_t counts[N_COUNTERS] = {}; // while running; see count()
+    uint64_t enabledNs = 0, runningNs = 0;
+
+    // Estimated over the whole time enabled; NaN if the counters never ran
+    double count(Counter c) const;
+  };
+
+  AlgProfiler(size_t nAlgs);
+  ~AlgProfiler();
+  AlgProfiler(const AlgProfiler&) = delete;
+  AlgProfiler& operator=(const AlgProfiler&) = delete;
+
+  // False if the counters couldn't be opened, or never got to run
+  bool hasCounters() const;
+  bool hasCounter(Counter c) const { return available_[c]; }
+  std::string whyNoCounters() const;
+
+  void start();
+  void stop(size_t iAlg);
+
+  const Totals& totals(size_t iAlg) const { return totals_.at(iAlg); }
+  void report(std::ostream& os, const std::vector<std::string>& algNames) const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Reading {
+    uint64_t enabledNs, runningNs;
+    uint64_t counts[N_COUNTERS];
+  };
+
+  bool readCounters(Reading& r) const;
+
+  int leader_ = -1;
+  std::vector<int> members_;
+  std::vector<Counter> slots_;  // which counter each group member is
+  bool available_[N_COUNTERS] = {};
+  std::string whyNot_;
+
+  Clock::time_point startTime_;
+  Reading start_ = {};
+  std::vector<Totals> totals_;
+};
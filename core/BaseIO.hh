@@ -4,6 +4,9 @@
 
 #include <TTree.h>
 
+#include <string>
+#include <vector>
+
 struct BranchManager;
 
 // TODO Replace TreeBase with a TreeWrapper<TreeData> where TreeData contains
@@ -45,7 +48,18 @@ char DataTypeToChar(EDataType datatype);
 // deputy assistant to the regional supervisor
 // TODO Replace with InputBranchManager and OutputBranchManager
 struct BranchManager {
-  enum class IOMode { IN, OUT };
+  // LAYOUT doesn't touch any tree; it just records where each branch's data
+  // lives in the TreeBase (used for the flat column cache)
+  enum class IOMode { IN, OUT, LAYOUT };
+
+  struct Column {
+    std::string name;
+    void* addr;
+    size_t size;                // bytes
+    std::string lenBranch;      // BR_VARLEN only: the column holding the length
+    size_t elemSize = 0;        // BR_VARLEN only
+  };
+  using Columns = std::vector<Column>;
 
   BranchManager(IOMode mode = IOMode::IN) : mode(mode) {}
 
@@ -58,6 +72,7 @@ struct BranchManager {
 
   IOMode mode;
   TTree* tree = nullptr;
+  Columns columns;              // LAYOUT mode only
 };
 
 template <typename T>
@@ -68,6 +83,15 @@ void BranchManager::branch(const char* name, T* ptr)
     tree->SetBranchAddress(name, ptr); // will this work for std::array in 6.19?
   }
 
+  else if (mode == IOMode::LAYOUT) {
+    columns.push_back({name, ptr, sizeof(T)});
+  }
+
+  else if (tree->GetBranch(name)) {
+    // existing tree, e.g. an output reopened after a checkpoint
+    tree->SetBranchAddress(name, (void*)ptr);
+  }
+
   else {
     // this should work in 6.19 even if T is a std::array
     do_branch(tree, name, ptr);
@@ -85,6 +109,15 @@ void BranchManager::branch(const char* name, std::array<T, N>* arrptr,
     tree->SetBranchAddress(name, arrptr->data());
   }
 
+  else if (mode == IOMode::LAYOUT) {
+    columns.push_back({name, arrptr->data(), sizeof(T) * N,
+                       len_branch ? len_branch : "", sizeof(T)});
+  }
+
+  else if (tree->GetBranch(name)) {
+    tree->SetBranchAddress(name, (void*)arrptr->data());
+  }
+
   else {
     const EDataType datatype = TDataType::GetType(typeid(T));
     const char typecode = DataTypeToChar(datatype);
@@ -0,0 +1,276 @@
+#include "ChainIndex.hh"
+
+#include "Strings.hh"
+
+#include <TFile.h>
+#include <TLeaf.h>
+#include <TTree.h>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+static constexpr const char* INDEX_MAGIC = "#SFCHAINIDX1";
+
+static bool isUInt(TTree* tree, const char* branch)
+{
+  TLeaf* leaf = tree->GetLeaf(branch);
+  return leaf && std::string(leaf->GetTypeName()) == "UInt_t";
+}
+
+namespace {
+
+// Exclusive flock on `path` (created if needed) for as long as this lives
+class FileLock {
+public:
+  FileLock(const std::string& path) :
+    fd_(open(path.c_str(), O_RDWR | O_CREAT, 0664))
+  {
+    if (fd_ < 0)
+      throw std::runtime_error(TmpStr("ChainIndex: can't open %s", path.c_str()));
+    if (flock(fd_, LOCK_EX) != 0) {
+      close(fd_);
+      throw std::runtime_error(TmpStr("ChainIndex: can't lock %s", path.c_str()));
+    }
+  }
+
+  ~FileLock() { close(fd_); }
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+private:
+  int fd_;
+};
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+
+ChainIndex::ChainIndex(const std::string& path) :
+  path_(path),
+  entries_(read(path))
+{
+}
+
+ChainIndex::~ChainIndex()
+{
+  try {
+    save();
+  } catch (const std::exception& e) {
+    std::cerr << "ChainIndex: " << e.what() << std::endl;
+  }
+}
+
+void ChainIndex::setTimeBranches(const char* secBranch, const char* nsecBranch)
+{
+  secBranch_ = secBranch;
+  nsecBranch_ = nsecBranch;
+}
+
+const FileIndex* ChainIndex::find(const std::string& file, const std::string& tree) const
+{
+  const auto it = entries_.find({file, tree});
+  if (it == entries_.end())
+    return nullptr;
+
+  FileIndex now;
+  if (!stamp(file, now) || now.size != it->second.size || now.mtime != it->second.mtime)
+    return nullptr;
+
+  return &it->second;
+}
+
+const FileIndex* ChainIndex::get(const std::string& file, const std::string& tree)
+{
+  if (const FileIndex* idx = find(file, tree))
+    return idx;
+
+  FileIndex stamped;
+  if (!stamp(file, stamped))
+    return nullptr;
+
+  FileIndex idx = scan(file, tree, secBranch_.c_str(), nsecBranch_.c_str());
+  idx.size = stamped.size;
+  idx.mtime = stamped.mtime;
+
+  put(file, tree, std::move(idx));
+  return &entries_[{file, tree}];
+}
+
+void ChainIndex::put(const std::string& file, const std::string& tree, FileIndex idx)
+{
+  ++nScanned_;
+  changed_[{file, tree}] = idx;
+  entries_[{file, tree}] = std::move(idx);
+}
+
+std::vector<std::pair<size_t, size_t>>
+ChainIndex::clusterRanges(const std::vector<std::string>& files, const std::string& tree,
+                          size_t n)
+{
+  std::vector<size_t> bounds;
+  size_t offset = 0;
+
+  for (const auto& file : files) {
+    const FileIndex* idx = get(file, tree);
+    if (!idx) {                 // do it the slow way
+      TChain chain(tree.c_str());
+      util::initChain(chain, files, this);
+      return util::clusterRanges(chain, n);
+    }
+
+    for (const size_t start : idx->clusters)
+      bounds.push_back(offset + start);
+    offset += idx->entries;
+  }
+  bounds.push_back(offset);
+
+  return util::splitAtBounds(bounds, n);
+}
+
+FileIndex ChainIndex::scan(const std::string& file, const std::string& tree,
+                           const char* secBranch, const char* nsecBranch)
+{
+  TDirectory::TContext ctx;
+
+  std::unique_ptr<TFile> f(TFile::Open(file.c_str()));
+  if (!f || f->IsZombie())
+    throw std::runtime_error(TmpStr("ChainIndex: can't open %s", file.c_str()));
+
+  TTree* t = nullptr;
+  f->GetObject(tree.c_str(), t);
+  if (!t)
+    throw std::runtime_error(TmpStr("ChainIndex: no %s in %s", tree.c_str(), file.c_str()));
+
+  return scan(t, secBranch, nsecBranch);
+}
+
+FileIndex ChainIndex::scan(TTree* t, const char* secBranch, const char* nsecBranch)
+{
+  FileIndex idx;
+  const Long64_t nEntries = t->GetEntries();
+  idx.entries = nEntries;
+
+  auto clusters = t->GetClusterIterator(0);
+  Long64_t start;
+  while ((start = clusters.Next()) < nEntries)
+    idx.clusters.push_back(start);
+
+  if (nEntries > 0 && isUInt(t, secBranch) && isUInt(t, nsecBranch)) {
+    UInt_t sec, nsec;
+    t->SetBranchStatus("*", false);
+    t->SetBranchStatus(secBranch, true);
+    t->SetBranchStatus(nsecBranch, true);
+    t->SetBranchAddress(secBranch, &sec);
+    t->SetBranchAddress(nsecBranch, &nsec);
+
+    t->GetEntry(0);
+    idx.firstTime = Time(sec, nsec);
+    t->GetEntry(nEntries - 1);
+    idx.lastTime = Time(sec, nsec);
+
+    t->ResetBranchAddresses();
+  }
+
+  return idx;
+}
+
+bool ChainIndex::stamp(const std::string& file, FileIndex& idx)
+{
+  struct stat st;
+  if (stat(file.c_str(), &st) != 0)
+    return false;
+
+  idx.size = st.st_size;
+  idx.mtime = st.st_mtim.tv_sec * 1'000'000'000LL + st.st_mtim.tv_nsec;
+  return true;
+}
+
+// One line per entry, tab-separated:
+// tree size mtime entries firstNanos lastNanos cluster,cluster,... path
+ChainIndex::Entries ChainIndex::read(const std::string& path)
+{
+  Entries entries;
+
+  std::ifstream ifs(path);
+  if (!ifs)
+    return entries;
+
+  std::string line;
+  if (!std::getline(ifs, line) || line != INDEX_MAGIC)
+    throw std::runtime_error(TmpStr("%s is not a chain index", path.c_str()));
+
+  while (std::getline(ifs, line)) {
+    std::istringstream iss(line);
+    std::string tree, clusters, file;
+    FileIndex idx;
+
+    std::getline(iss, tree, '\t');
+    iss >> idx.size >> idx.mtime >> idx.entries
+        >> idx.firstTime.nanos >> idx.lastTime.nanos >> clusters;
+    iss.ignore(1);
+    std::getline(iss, file);
+
+    if (!iss || file.empty())
+      throw std::runtime_error(TmpStr("Chain index %s is corrupt", path.c_str()));
+
+    if (clusters != "-") {
+      std::istringstream css(clusters);
+      for (std::string c; std::getline(css, c, ',');)
+        idx.clusters.push_back(std::stoul(c));
+    }
+
+    entries[{file, tree}] = std::move(idx);
+  }
+
+  return entries;
+}
+
+void ChainIndex::save()
+{
+  if (changed_.empty())
+    return;
+
+  // Held until we return, so that no other job saves between our read and
+  // our rename (and loses our entries, or makes us lose theirs)
+  const FileLock lock(path_ + ".lock");
+
+  // Keep whatever other jobs have added in the meantime
+  Entries merged = read(path_);
+  for (auto& [key, idx] : changed_)
+    merged[key] = std::move(idx);
+
+  const std::string tmpPath = path_ + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream ofs(tmpPath, std::ios::trunc);
+    ofs << INDEX_MAGIC << "\n";
+
+    for (const auto& [key, idx] : merged) {
+      std::string clusters;
+      for (const size_t c : idx.clusters)
+        clusters += (clusters.empty() ? "" : ",") + std::to_string(c);
+
+      ofs << key.second << "\t" << idx.size << "\t" << idx.mtime << "\t" << idx.entries
+          << "\t" << idx.firstTime.nanos << "\t" << idx.lastTime.nanos
+          << "\t" << (clusters.empty() ? "-" : clusters) << "\t" << key.first << "\n";
+    }
+
+    if (!ofs)
+      throw std::runtime_error(TmpStr("ChainIndex: can't write %s", tmpPath.c_str()));
+  }
+
+  if (std::rename(tmpPath.c_str(), path_.c_str()) != 0)
+    throw std::runtime_error(TmpStr("ChainIndex: can't rename %s", tmpPath.c_str()));
+
+  changed_.clear();
+  entries_ = std::move(merged);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Util.hh"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class TTree;
+
+// What a chain needs to know about one tree in one input file
+struct FileIndex {
+  long long size = 0;           // of the file when it was indexed
+  long long mtime = 0;          // ns
+  size_t entries = 0;
+  std::vector<size_t> clusters; // (local) first entry of each cluster
+  Time firstTime, lastTime;     // of the first/last trigger, if known
+};
+
+// Persistent sidecar index of input files, so that chains can be set up (and
+// split into cluster ranges) without opening every file. Stored as a text
+// file with one line per (file, tree). An entry is only trusted while the
+// file's size and mtime still match; otherwise the file is reindexed. Files
+// that can't be stat()ed (e.g. remote URLs) are never indexed.
+//
+// Several jobs may share one index: save() holds an flock on "<path>.lock"
+// while it merges with whatever is on disk and replaces it atomically.
+class ChainIndex {
+public:
+  static constexpr const char* DEFAULT_SEC_BRANCH = "triggerTimeSec";
+  static constexpr const char* DEFAULT_NSEC_BRANCH = "triggerTimeNanoSec";
+
+  ChainIndex(const std::string& path);
+  ~ChainIndex();                // saves any changes
+  ChainIndex(const ChainIndex&) = delete;
+  ChainIndex& operator=(const ChainIndex&) = delete;
+
+  // UInt_t branches holding the trigger time; missing ones are skipped
+  void setTimeBranches(const char* secBranch, const char* nsecBranch);
+  const char* secBranch() const { return secBranch_.c_str(); }
+  const char* nsecBranch() const { return nsecBranch_.c_str(); }
+
+  // Up-to-date entry, or null if the file has none (or can't be indexed).
+  // Pointers stay valid until the next save().
+  const FileIndex* find(const std::string& file, const std::string& tree) const;
+  // Same, but (re)indexes the file if needed
+  const FileIndex* get(const std::string& file, const std::string& tree);
+  // Record an entry made elsewhere (e.g. by validateInputs, which has the
+  // file open anyway). idx must be stamp()ed from before it was scanned.
+  void put(const std::string& file, const std::string& tree, FileIndex idx);
+
+  // For a list of files, as in util::clusterRanges (which opens every file)
+  std::vector<std::pair<size_t, size_t>>
+  clusterRanges(const std::vector<std::string>& files, const std::string& tree, size_t n);
+
+  void save();
+  size_t nScanned() const { return nScanned_; } // files (re)indexed so far
+
+  // Read the index information straight from the file (the stamp excepted)
+  static FileIndex scan(const std::string& file, const std::string& tree,
+                        const char* secBranch = DEFAULT_SEC_BRANCH,
+                        const char* nsecBranch = DEFAULT_NSEC_BRANCH);
+  static FileIndex scan(TTree* tree, const char* secBranch = DEFAULT_SEC_BRANCH,
+                        const char* nsecBranch = DEFAULT_NSEC_BRANCH);
+  // Set the size and mtime; false if the file can't be stat()ed
+  static bool stamp(const std::string& file, FileIndex& idx);
+
+private:
+  using Key = std::pair<std::string, std::string>; // file, tree
+  using Entries = std::map<Key, FileIndex>;
+
+  static Entries read(const std::string& path);
+
+  std::string path_;
+  std::string secBranch_ = DEFAULT_SEC_BRANCH;
+  std::string nsecBranch_ = DEFAULT_NSEC_BRANCH;
+  Entries entries_;
+  Entries changed_;             // to be merged into the file by save()
+  size_t nScanned_ = 0;
+};
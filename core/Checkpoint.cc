@@ -0,0 +1,327 @@
+#include "Checkpoint.hh"
+
+#include "Kernel.hh"
+#include "Strings.hh"
+#include "Util.hh"
+
+#include <TFile.h>
+#include <TH1.h>
+#include <TKey.h>
+#include <TList.h>
+#include <TTree.h>
+
+#include <cstdio>
+#include <stdexcept>
+#include <typeinfo>
+
+static constexpr const char* CHECKPOINT_MAGIC = "SFCHKPT1";
+
+void StateWriter::putRaw(const void* ptr, size_t n)
+{
+  const char* p = static_cast<const char*>(ptr);
+  bytes_.insert(bytes_.end(), p, p + n);
+}
+
+void StateWriter::put(const std::string& str)
+{
+  put(str.size());
+  putRaw(str.data(), str.size());
+}
+
+void StateReader::getRaw(void* ptr, size_t n)
+{
+  if (n > size_ - pos_)
+    throw std::runtime_error(TmpStr("Checkpoint: state of %s is truncated", what_.c_str()));
+
+  memcpy(ptr, data_ + pos_, n);
+  pos_ += n;
+}
+
+void StateReader::get(std::string& str)
+{
+  size_t n;
+  get(n);
+  str.resize(n);
+  getRaw(&str[0], n);
+}
+
+// -----------------------------------------------------------------------------
+
+// Every in-memory object under dir, with its path relative to dir
+static void listObjects(TDirectory& dir, const std::string& prefix,
+                        std::vector<std::pair<std::string, TObject*>>& objs)
+{
+  for (TObject* obj : *dir.GetList()) {
+    const std::string path = prefix + obj->GetName();
+    if (auto sub = dynamic_cast<TDirectory*>(obj))
+      listObjects(*sub, path + "/", objs);
+    else
+      objs.emplace_back(path, obj);
+  }
+}
+
+// The directory part of `path` (relative to top), and the name part
+static std::pair<TDirectory*, std::string> splitPath(TDirectory& top, const std::string& path)
+{
+  const auto slash = path.rfind('/');
+  if (slash == std::string::npos)
+    return {&top, path};
+  return {top.GetDirectory(path.substr(0, slash).c_str()), path.substr(slash + 1)};
+}
+
+struct Checkpointer::Saved {
+  using NodeState = std::pair<std::string, std::vector<char>>; // type, state
+
+  std::unique_ptr<TFile> file;  // holds the histograms
+  std::vector<TreeMark> trees;
+  std::vector<HistMark> hists;
+  std::vector<NodeState> algs, tools;
+  std::vector<char> results;
+};
+
+Checkpointer::Checkpointer(const std::string& path, size_t everyCycles) :
+  path_(path), everyCycles_(everyCycles)
+{
+  if (everyCycles_ == 0)
+    throw std::runtime_error("Checkpointer: everyCycles must be positive");
+
+  if (!util::fileExists(path_))
+    return;
+
+  TDirectory::TContext ctx;     // don't leave gDirectory pointing at the file
+
+  auto file = std::make_unique<TFile>(path_.c_str(), "READ");
+  std::vector<char>* state = nullptr;
+  if (!file->IsZombie())
+    file->GetObject("state", state);
+  if (!state)
+    throw std::runtime_error(TmpStr("Checkpoint %s is unreadable", path_.c_str()));
+
+  StateReader r(state->data(), state->size(), path_);
+  std::string magic;
+  r.get(magic);
+  if (magic != CHECKPOINT_MAGIC)
+    throw std::runtime_error(TmpStr("%s is not a checkpoint", path_.c_str()));
+
+  saved_ = std::make_unique<Saved>();
+  saved_->file = std::move(file);
+
+  size_t nTrees;
+  r.get(nTrees);
+  saved_->trees.resize(nTrees);
+  for (auto& mark : saved_->trees) {
+    r.get(mark.outFile);
+    r.get(mark.tree);
+    r.get(mark.entries);
+  }
+
+  size_t nHists;
+  r.get(nHists);
+  saved_->hists.resize(nHists);
+  for (auto& mark : saved_->hists) {
+    r.get(mark.outFile);
+    r.get(mark.hist);
+  }
+
+  for (auto* nodes : {&saved_->algs, &saved_->tools}) {
+    size_t n;
+    r.get(n);
+    nodes->resize(n);
+    for (auto& [type, bytes] : *nodes) {
+      r.get(type);
+      r.get(bytes);
+    }
+  }
+
+  r.get(saved_->results);
+  delete state;
+}
+
+Checkpointer::~Checkpointer()
+{
+  if (done_)
+    std::remove(path_.c_str());
+}
+
+void Checkpointer::save(Pipeline& pipeline)
+{
+  TDirectory::TContext ctx;
+
+  const std::string tmpPath = path_ + ".tmp";
+  TFile file(tmpPath.c_str(), "RECREATE");
+  if (file.IsZombie())
+    throw std::runtime_error(TmpStr("Checkpoint: can't create %s", tmpPath.c_str()));
+
+  // Flush the output trees first, so that the checkpoint never claims more
+  // entries than are safely on disk. Other histograms are copied as is.
+  std::vector<TreeMark> trees;
+  std::vector<HistMark> hists;
+  for (const auto& [name, outFile] : pipeline.outFileMap) {
+    if (!outFile)
+      continue;
+
+    std::vector<std::pair<std::string, TObject*>> objs;
+    listObjects(*outFile, "", objs);
+
+    for (const auto& [path, obj] : objs) {
+      if (auto tree = dynamic_cast<TTree*>(obj)) {
+        tree->AutoSave("FlushBaskets SaveSelf");
+        trees.push_back({name, path, tree->GetEntries()});
+      } else if (auto hist = dynamic_cast<TH1*>(obj)) {
+        if (pipeline.results_.holds(hist))
+          continue;             // saved with the ResultSet
+        file.WriteTObject(hist, TmpStr("out%zu", hists.size()));
+        hists.push_back({name, path});
+      } else {
+        throw std::runtime_error(TmpStr("Checkpoint: can't save %s (a %s) in %s",
+                                        path.c_str(), obj->ClassName(), outFile->GetName()));
+      }
+    }
+
+    outFile->Flush();
+  }
+
+  StateWriter w;
+  w.put(std::string(CHECKPOINT_MAGIC));
+
+  w.put(trees.size());
+  for (const auto& mark : trees) {
+    w.put(mark.outFile);
+    w.put(mark.tree);
+    w.put(mark.entries);
+  }
+
+  w.put(hists.size());
+  for (const auto& mark : hists) {
+    w.put(mark.outFile);
+    w.put(mark.hist);
+  }
+
+  auto putNodes = [&](const auto& nodes) {
+    w.put(nodes.size());
+    for (const auto& node : nodes) {
+      StateWriter nodeWriter;
+      node->saveState(nodeWriter);
+      w.put(std::string(typeid(*node.get()).name()));
+      w.put(nodeWriter.bytes());
+    }
+  };
+
+  putNodes(pipeline.algVec);
+  putNodes(pipeline.toolVec);
+
+  StateWriter resultsWriter;
+  pipeline.results_.saveState(resultsWriter, file);
+  w.put(resultsWriter.bytes());
+
+  file.WriteObject(&w.bytes(), "state");
+  file.Close();
+
+  if (std::rename(tmpPath.c_str(), path_.c_str()) != 0)
+    throw std::runtime_error(TmpStr("Checkpoint: can't rename %s", tmpPath.c_str()));
+}
+
+void Checkpointer::checkNodes(const Pipeline& pipeline) const
+{
+  auto check = [](const auto& nodes) {
+    for (const auto& node : nodes) {
+      if (!node->carriesState())
+        continue;
+      StateWriter w;
+      node->saveState(w);
+      if (w.bytes().empty())
+        throw std::runtime_error(TmpStr("Checkpoint: %s carries state but doesn't save it",
+                                        util::demangle(typeid(*node.get()).name()).c_str()));
+    }
+  };
+
+  check(pipeline.algVec);
+  check(pipeline.toolVec);
+}
+
+void Checkpointer::restore(Pipeline& pipeline)
+{
+  auto loadNodes = [&](const auto& nodes, const std::vector<Saved::NodeState>& states) {
+    if (nodes.size() != states.size())
+      throw std::runtime_error(TmpStr("Checkpoint %s was made by a different pipeline",
+                                      path_.c_str()));
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      const auto& [type, bytes] = states[i];
+      if (type != typeid(*nodes[i].get()).name())
+        throw std::runtime_error(TmpStr("Checkpoint %s: expected %s, found %s",
+                                        path_.c_str(), type.c_str(),
+                                        typeid(*nodes[i].get()).name()));
+
+      StateReader r(bytes.data(), bytes.size(), type);
+      nodes[i]->loadState(r);
+      if (!r.atEnd())
+        throw std::runtime_error(TmpStr("Checkpoint: %s didn't load all of its state",
+                                        type.c_str()));
+    }
+  };
+
+  loadNodes(pipeline.algVec, saved_->algs);
+  loadNodes(pipeline.toolVec, saved_->tools);
+
+  StateReader r(saved_->results.data(), saved_->results.size(), "results");
+  pipeline.results_.loadState(r, *saved_->file);
+
+  // The algorithms have created their histograms again (empty) by now
+  for (size_t i = 0; i < saved_->hists.size(); ++i) {
+    const auto& mark = saved_->hists[i];
+    TFile* outFile = pipeline.getOutFile(mark.outFile.c_str());
+    const auto [dir, name] = outFile ? splitPath(*outFile, mark.hist) :
+      std::pair<TDirectory*, std::string>(nullptr, "");
+    TH1* hist = dir ? dynamic_cast<TH1*>(dir->GetList()->FindObject(name.c_str())) : nullptr;
+
+    TH1* saved = nullptr;
+    saved_->file->GetObject(TmpStr("out%zu", i), saved);
+    if (!hist || !saved)
+      throw std::runtime_error(TmpStr("Checkpoint: can't restore %s in output '%s'",
+                                      mark.hist.c_str(), mark.outFile.c_str()));
+
+    hist->Reset();
+    hist->Add(saved);
+    delete saved;
+  }
+
+  saved_->file.reset();
+}
+
+void Checkpointer::truncateTrees(TFile& file, const std::string& name) const
+{
+  for (const auto& mark : saved_->trees) {
+    if (mark.outFile != name)
+      continue;
+
+    const auto [dir, treeName] = splitPath(file, mark.tree);
+    TTree* tree = nullptr;
+    if (dir)
+      dir->GetObject(treeName.c_str(), tree);
+    if (!tree || tree->GetEntries() < mark.entries)
+      throw std::runtime_error(TmpStr("Checkpoint: %s in %s is missing entries",
+                                      mark.tree.c_str(), file.GetName()));
+
+    if (tree->GetEntries() == mark.entries)
+      continue;
+
+    // Entries past the checkpoint were written by the interrupted run. Copy
+    // the good ones into a new tree and drop every saved cycle of the old one.
+    std::vector<short> cycles;
+    for (TObject* obj : *dir->GetListOfKeys()) {
+      auto key = static_cast<TKey*>(obj);
+      if (treeName == key->GetName())
+        cycles.push_back(key->GetCycle());
+    }
+
+    TTree* cut = tree->CloneTree(mark.entries);
+    delete tree;
+
+    for (short cycle : cycles)
+      dir->Delete(TmpStr("%s;%d", treeName.c_str(), cycle));
+
+    cut->SetDirectory(dir);
+    cut->Write();
+  }
+}
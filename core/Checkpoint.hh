@@ -0,0 +1,246 @@
+#pragma once
+
+#include "BaseIO.hh"
+#include "RingBuf.hh"
+
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class Pipeline;
+class TDirectory;
+class TFile;
+
+// Byte-level (de)serialization for Node::saveState / loadState. Values must
+// be trivially copyable, or TreeBase data (e.g. a reader's events), which is
+// saved branch by branch as declared by initBranches(). A checkpoint is only
+// meant to be read back by the same build of the same job.
+class StateWriter {
+public:
+  template <class T>
+  void put(const T& x);
+
+  template <class T>
+  void put(const std::vector<T>& vec);
+
+  template <class T>
+  void put(const std::deque<T>& deq);
+
+  template <class T>
+  void put(const RingBuf<T>& ring);
+
+  void put(const std::string& str);
+
+  const std::vector<char>& bytes() const { return bytes_; }
+
+private:
+  template <class T, class Seq>
+  void putSeq(const Seq& seq);
+
+  void putRaw(const void* ptr, size_t n);
+
+  std::vector<char> bytes_;
+};
+
+class StateReader {
+public:
+  StateReader(const char* data, size_t size, const std::string& what) :
+    data_(data), size_(size), what_(what) {}
+
+  template <class T>
+  void get(T& x);
+
+  template <class T>
+  void get(std::vector<T>& vec);
+
+  template <class T>
+  void get(std::deque<T>& deq);
+
+  // Items are put() into the ring, which keeps its own capacity
+  template <class T>
+  void get(RingBuf<T>& ring);
+
+  void get(std::string& str);
+
+  bool atEnd() const { return pos_ == size_; }
+
+private:
+  template <class Seq>
+  void getSeq(Seq& seq);
+
+  void getRaw(void* ptr, size_t n);
+
+  const char* data_;
+  size_t size_;
+  size_t pos_ = 0;
+  std::string what_;
+};
+
+// Periodically saves the state of a Pipeline (see Pipeline::enableCheckpoints)
+// and restores it when a job is restarted. A checkpoint holds:
+//  - each Algorithm's and Tool's saveState(), in order of creation
+//  - the ResultSet's histograms and counters
+//  - copies of the other histograms held by the output files
+//  - the number of entries of each output tree, flushed to disk just before
+//    the checkpoint is written
+// Output files are searched through all their subdirectories. Any other kind
+// of object found in them can't be restored, so it makes save() throw; so
+// does a Node that carriesState() but saves nothing (checked at connect).
+// It is written to "<path>.tmp" and renamed over <path>, so a preempted job
+// always leaves a complete checkpoint behind. On resume, output files are
+// opened for UPDATE and their trees are cut back to the checkpointed entries,
+// so the finished outputs match those of an uninterrupted run. The checkpoint
+// is removed once the Pipeline is done and its outputs are closed.
+class Checkpointer {
+public:
+  Checkpointer(const std::string& path, size_t everyCycles);
+  ~Checkpointer();
+
+  bool resuming() const { return bool(saved_); }
+
+  bool due() { return ++cycles_ % everyCycles_ == 0; }
+  void save(Pipeline& pipeline);
+  void restore(Pipeline& pipeline);
+  void markDone() { done_ = true; }
+
+  // Throws if a Node that carriesState() doesn't implement saveState
+  void checkNodes(const Pipeline& pipeline) const;
+
+  // Called by Pipeline::makeOutFile when resuming
+  void truncateTrees(TFile& file, const std::string& name) const;
+
+private:
+  struct TreeMark {
+    std::string outFile, tree;  // tree: path within the file
+    long long entries;
+  };
+
+  struct HistMark {
+    std::string outFile, hist;  // ditto
+  };
+
+  struct Saved;
+
+  std::string path_;
+  size_t everyCycles_;
+  size_t cycles_ = 0;
+  bool done_ = false;
+
+  std::unique_ptr<Saved> saved_;
+};
+
+// -----------------------------------------------------------------------------
+
+// {offset, size} of each branch's data within a T, from a LAYOUT pass over a
+// default-constructed one (see BranchManager). Computed once per type.
+template <class T>
+const std::vector<std::pair<size_t, size_t>>& branchLayout()
+{
+  static const auto layout = [] {
+    T proto;
+    BranchManager mgr(BranchManager::IOMode::LAYOUT);
+    proto.setManager(&mgr);
+    proto.initBranches();
+
+    std::vector<std::pair<size_t, size_t>> result;
+    const char* base = reinterpret_cast<const char*>(&proto);
+    for (const auto& col : mgr.columns)
+      result.emplace_back(static_cast<const char*>(col.addr) - base, col.size);
+    return result;
+  }();
+
+  return layout;
+}
+
+template <class T>
+void StateWriter::put(const T& x)
+{
+  if constexpr (std::is_base_of_v<TreeBase, T>) {
+    for (const auto& [offset, size] : branchLayout<T>())
+      putRaw(reinterpret_cast<const char*>(&x) + offset, size);
+  } else {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "StateWriter: only trivially copyable types can be saved");
+    putRaw(&x, sizeof(T));
+  }
+}
+
+template <class T, class Seq>
+void StateWriter::putSeq(const Seq& seq)
+{
+  put(seq.size());
+  for (const T& x : seq)
+    put(x);
+}
+
+template <class T>
+void StateWriter::put(const std::vector<T>& vec)
+{
+  putSeq<T>(vec);
+}
+
+template <class T>
+void StateWriter::put(const std::deque<T>& deq)
+{
+  putSeq<T>(deq);
+}
+
+template <class T>
+void StateWriter::put(const RingBuf<T>& ring)
+{
+  put(ring.size());
+  for (size_t i = ring.size(); i-- > 0; ) // oldest first
+    put(ring.at(i));
+}
+
+template <class T>
+void StateReader::get(T& x)
+{
+  if constexpr (std::is_base_of_v<TreeBase, T>) {
+    for (const auto& [offset, size] : branchLayout<T>())
+      getRaw(reinterpret_cast<char*>(&x) + offset, size);
+  } else {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "StateReader: only trivially copyable types can be loaded");
+    getRaw(&x, sizeof(T));
+  }
+}
+
+template <class Seq>
+void StateReader::getSeq(Seq& seq)
+{
+  size_t n;
+  get(n);
+  seq.resize(n);
+  for (auto& x : seq)
+    get(x);
+}
+
+template <class T>
+void StateReader::get(std::vector<T>& vec)
+{
+  getSeq(vec);
+}
+
+template <class T>
+void StateReader::get(std::deque<T>& deq)
+{
+  getSeq(deq);
+}
+
+template <class T>
+void StateReader::get(RingBuf<T>& ring)
+{
+  size_t n;
+  get(n);
+  ring.clear();
+  for (size_t i = 0; i < n; ++i) {
+    T x;
+    get(x);
+    ring.put(x);
+  }
+}
@@ -1,5 +1,7 @@
 #include "Clock.hh"
 
+#include "Checkpoint.hh"
+
 #include <stdexcept>
 
 void Clock::registerWriter(Algorithm*)
@@ -8,3 +10,15 @@ void Clock::registerWriter(Algorithm*)
   if (nWriters > 1)
     throw std::runtime_error("Attempted to register multiple clock writers!");
 }
+
+void Clock::saveState(StateWriter& w) const
+{
+  w.put(current_);
+  w.put(atTheEnd_);
+}
+
+void Clock::loadState(StateReader& r)
+{
+  r.get(current_);
+  r.get(atTheEnd_);
+}
@@ -11,6 +11,9 @@ public:
   void signalTheEnd() { atTheEnd_ = true; };
   void registerWriter(Algorithm*);
 
+  void saveState(StateWriter& w) const override;
+  void loadState(StateReader& r) override;
+
 private:
   Time current_;
   bool atTheEnd_ = false;
@@ -0,0 +1,269 @@
+#pragma once
+
+#include "Checkpoint.hh"
+#include "Kernel.hh"
+#include "RingBuf.hh"
+#include "SimpleAlg.hh"
+#include "Strings.hh"
+#include "Util.hh"
+
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+// Prompt/delayed coincidence cuts. A (prompt, delayed) pair is selected when
+//  - dtMin_us <= t_delayed - t_prompt <= dtMax_us,
+//  - no other prompt-like event lies in [t_prompt - preIsolation_us, t_delayed)
+//    or in [t_delayed - dtMax_us, t_delayed) (i.e. prompt multiplicity is 1),
+//  - no other delayed-like event lies in (t_prompt, t_delayed + postIsolation_us].
+// An event can be both prompt-like and delayed-like.
+struct CoincidenceWindow {
+  double dtMin_us = 1;
+  double dtMax_us = 200;
+  double preIsolation_us = 0;
+  double postIsolation_us = 0;
+};
+
+// Streaming pair finder for one time-ordered stream. O(1) work and no
+// allocation per event: only the last two prompt-like events (in a RingBuf)
+// and at most one pair waiting out its post-isolation window are kept.
+template <class T>
+class CoincidenceFinder {
+public:
+  using Emit = std::function<void(const T& prompt, const T& delayed)>;
+
+  CoincidenceFinder(const CoincidenceWindow& window = {}, Emit emit = {});
+
+  void setEmit(Emit emit) { emit_ = std::move(emit); }
+
+  void add(Time t, const T& item, bool isPrompt, bool isDelayed);
+  void flush();                 // emit the pending pair, if any (end of stream)
+
+  size_t nPairs() const { return nPairs_; }
+
+  // The window and the emit function aren't saved; they come from the ctor
+  void saveState(StateWriter& w) const;
+  void loadState(StateReader& r);
+
+private:
+  struct Entry {
+    Time t;
+    T item;
+  };
+
+  void onDelayed(Time t, const T& item);
+
+  int64_t dtMin_ns_, dtMax_ns_, pre_ns_, post_ns_;
+  Emit emit_;
+
+  RingBuf<Entry> prompts_;
+  Entry pendingPrompt_, pendingDelayed_;
+  bool pending_ = false;
+  Time lastDelayed_;
+  size_t nPairs_ = 0;
+};
+
+// Wraps one CoincidenceFinder per partition (e.g. detector) around a reader.
+// Subclasses classify events and receive the selected pairs in pair(). The
+// pending pairs are flushed in finalize().
+template <class ReaderT, class TagT = int>
+class CoincidenceAlg : public SimpleAlg<ReaderT, TagT> {
+public:
+  using Data = algdata_t<ReaderT>;
+
+  using SimpleAlg<ReaderT, TagT>::SimpleAlg;
+
+  // Must be called (before the loop) to set the cuts
+  void setWindow(const CoincidenceWindow& window, size_t nPartitions = 1);
+
+  Algorithm::Status consume(const Data& data) override;
+  void finalize(Pipeline& pipeline) override;
+  bool carriesState() const override { return true; }
+  void saveState(StateWriter& w) const override;
+  void loadState(StateReader& r) override;
+
+  virtual Time timeOf(const Data& data) const = 0;
+  virtual bool isPrompt(const Data& data) const = 0;
+  virtual bool isDelayed(const Data& data) const = 0;
+  virtual size_t partition(const Data& data) const { return 0; }
+  virtual void pair(const Data& prompt, const Data& delayed) = 0;
+
+  const CoincidenceFinder<Data>& finder(size_t part) const { return finders_[part]; }
+
+private:
+  std::vector<CoincidenceFinder<Data>> finders_;
+};
+
+// -----------------------------------------------------------------------------
+
+template <class T>
+CoincidenceFinder<T>::CoincidenceFinder(const CoincidenceWindow& window, Emit emit) :
+  dtMin_ns_(std::llround(1e3 * window.dtMin_us)),
+  dtMax_ns_(std::llround(1e3 * window.dtMax_us)),
+  pre_ns_(std::llround(1e3 * window.preIsolation_us)),
+  post_ns_(std::llround(1e3 * window.postIsolation_us)),
+  emit_(std::move(emit)),
+  prompts_(2)
+{
+  if (dtMin_ns_ > dtMax_ns_)
+    throw std::runtime_error(TmpStr("CoincidenceWindow: dtMin_us %g > dtMax_us %g",
+                                    window.dtMin_us, window.dtMax_us));
+}
+
+template <class T>
+inline
+void CoincidenceFinder<T>::add(Time t, const T& item, bool isPrompt, bool isDelayed)
+{
+  if (pending_ && t.diff_ns(pendingDelayed_.t) > post_ns_) {
+    pending_ = false;
+    ++nPairs_;
+    if (emit_)
+      emit_(pendingPrompt_.item, pendingDelayed_.item);
+  }
+
+  // As a delayed, pair with the earlier prompts (so not with itself)
+  if (isDelayed)
+    onDelayed(t, item);
+
+  if (isPrompt)
+    prompts_.put({t, item});
+}
+
+template <class T>
+void CoincidenceFinder<T>::onDelayed(Time t, const T& item)
+{
+  // Still inside the previous pair's post-isolation window
+  pending_ = false;
+
+  const Time prevDelayed = lastDelayed_;
+  lastDelayed_ = t;
+
+  if (prompts_.size() == 0)
+    return;
+
+  const Entry& prompt = prompts_.at(0);
+  const int64_t dt = t.diff_ns(prompt.t);
+  if (dt < dtMin_ns_ || dt > dtMax_ns_)
+    return;
+
+  if (prevDelayed > prompt.t)   // another delayed-like since the prompt
+    return;
+
+  if (prompts_.size() > 1) {
+    const Time before = prompts_.at(1).t;
+    if (t.diff_ns(before) <= dtMax_ns_ || prompt.t.diff_ns(before) <= pre_ns_)
+      return;
+  }
+
+  pendingPrompt_ = prompt;
+  pendingDelayed_ = {t, item};
+  pending_ = true;
+}
+
+template <class T>
+void CoincidenceFinder<T>::flush()
+{
+  if (pending_) {
+    pending_ = false;
+    ++nPairs_;
+    if (emit_)
+      emit_(pendingPrompt_.item, pendingDelayed_.item);
+  }
+}
+
+// Entries are saved field by field, since T may be a reader's TreeBase data
+template <class T>
+void CoincidenceFinder<T>::saveState(StateWriter& w) const
+{
+  w.put(prompts_.size());
+  for (size_t i = prompts_.size(); i-- > 0; ) { // oldest first
+    w.put(prompts_.at(i).t);
+    w.put(prompts_.at(i).item);
+  }
+  for (const Entry* e : {&pendingPrompt_, &pendingDelayed_}) {
+    w.put(e->t);
+    w.put(e->item);
+  }
+  w.put(pending_);
+  w.put(lastDelayed_);
+  w.put(nPairs_);
+}
+
+template <class T>
+void CoincidenceFinder<T>::loadState(StateReader& r)
+{
+  size_t n;
+  r.get(n);
+  prompts_.clear();
+  for (size_t i = 0; i < n; ++i) {
+    Entry e;
+    r.get(e.t);
+    r.get(e.item);
+    prompts_.put(e);
+  }
+  for (Entry* e : {&pendingPrompt_, &pendingDelayed_}) {
+    r.get(e->t);
+    r.get(e->item);
+  }
+  r.get(pending_);
+  r.get(lastDelayed_);
+  r.get(nPairs_);
+}
+
+// -----------------------------------------------------------------------------
+
+template <class ReaderT, class TagT>
+void CoincidenceAlg<ReaderT, TagT>::setWindow(const CoincidenceWindow& window,
+                                              size_t nPartitions)
+{
+  finders_.clear();
+  finders_.reserve(nPartitions);
+  for (size_t i = 0; i < nPartitions; ++i)
+    finders_.emplace_back(window, [this](const Data& prompt, const Data& delayed) {
+      pair(prompt, delayed);
+    });
+}
+
+template <class ReaderT, class TagT>
+Algorithm::Status CoincidenceAlg<ReaderT, TagT>::consume(const Data& data)
+{
+  const bool prompt = isPrompt(data), delayed = isDelayed(data);
+  if (!prompt && !delayed)
+    return Algorithm::Status::Continue;
+
+  const size_t part = partition(data);
+  if (part >= finders_.size())
+    throw std::runtime_error(TmpStr("CoincidenceAlg: partition %zu out of range (%zu partitions)",
+                                    part, finders_.size()));
+
+  finders_[part].add(timeOf(data), data, prompt, delayed);
+  return Algorithm::Status::Continue;
+}
+
+template <class ReaderT, class TagT>
+void CoincidenceAlg<ReaderT, TagT>::finalize(Pipeline& pipeline)
+{
+  for (auto& finder : finders_)
+    finder.flush();
+}
+
+template <class ReaderT, class TagT>
+void CoincidenceAlg<ReaderT, TagT>::saveState(StateWriter& w) const
+{
+  w.put(finders_.size());
+  for (const auto& finder : finders_)
+    finder.saveState(w);
+}
+
+template <class ReaderT, class TagT>
+void CoincidenceAlg<ReaderT, TagT>::loadState(StateReader& r)
+{
+  size_t n;
+  r.get(n);
+  if (n != finders_.size())
+    throw std::runtime_error(TmpStr("CoincidenceAlg: checkpoint has %zu partitions, not %zu",
+                                    n, finders_.size()));
+  for (auto& finder : finders_)
+    finder.loadState(r);
+}
@@ -1,6 +1,7 @@
 #include "ConfigTool.hh"
 
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <tuple>
 #include <stdexcept>
@@ -129,15 +130,45 @@ Config::Config(const char* confFile)
     if (line.empty()) continue;
 
     const auto [key, valStr] = split_line(line);
+    set(key, valStr);
+  }
+}
+
+Config::Config(const Config& other) :
+  Tool(other.rawTag_),
+  intMap(other.intMap),
+  floatMap(other.floatMap),
+  strMap(other.strMap) {}
 
-    try {
-      const bool maybeFloat = valStr.find('.') != std::string::npos;
-      if (maybeFloat)
-        floatMap[key] = stod(valStr);
-      else
-        intMap[key] = stoi(valStr);
-    } catch (std::invalid_argument&) {
-      strMap[key] = valStr;
-    }
+void Config::set(const std::string& key, const std::string& valStr)
+{
+  // an override may change the type, so forget any previous value
+  intMap.erase(key);
+  floatMap.erase(key);
+  strMap.erase(key);
+
+  try {
+    const bool maybeFloat = valStr.find('.') != std::string::npos;
+    if (maybeFloat)
+      floatMap[key] = stod(valStr);
+    else
+      intMap[key] = stoi(valStr);
+  } catch (std::invalid_argument&) {
+    strMap[key] = valStr;
   }
 }
+
+std::string Config::serialize() const
+{
+  std::ostringstream oss;
+  oss.precision(17);
+
+  for (const auto& [key, val] : intMap)
+    oss << key << " " << val << "\n";
+  for (const auto& [key, val] : floatMap)
+    oss << key << " " << val << "\n";
+  for (const auto& [key, val] : strMap)
+    oss << key << " " << val << "\n";
+
+  return oss.str();
+}
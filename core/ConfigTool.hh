@@ -12,10 +12,17 @@
 class Config : public Tool {
 public:
   Config(const char* confFile);
+  Config(const Config& other);  // e.g. as the base for a Sweep variant
+
+  // Same parsing as a line in the conf file
+  void set(const std::string& key, const std::string& valStr);
 
   template <class T>
   T get(const char* key, std::optional<T> dflt = std::nullopt) const;
 
+  // All values as sorted "key value" lines, e.g. for hashing
+  std::string serialize() const;
+
 private:
   std::map<std::string, int> intMap;
   std::map<std::string, double> floatMap;
@@ -1,24 +1,77 @@
 #pragma once
 
 #include "BaseIO.hh"
+#include "FlatFile.hh"
+#include "IOStats.hh"
+#include "Strings.hh"
 
 #include <TFile.h>
 #include <TTree.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
 template <class TreeT>          // TreeT <: TreeBase
 class DirectReader {
 public:
   DirectReader() {};
   DirectReader(TFile* file, const char* treeName);
   void init(TFile* file, const char* treeName);
+  // Keeps the (e.g. Pipeline::inFileShared) file open for as long as we use it
+  DirectReader(std::shared_ptr<TFile> file, const char* treeName);
+  void init(std::shared_ptr<TFile> file, const char* treeName);
+  void initFlat(const char* flatPath); // instead of init(); see FlatFile.hh
   size_t size();
   void loadEntry(size_t entry);
   const TreeT& at(size_t entry);
 
+  // Snapshot mode: Read every registered branch into memory once, as one
+  // contiguous array per branch (BR_VARLEN arrays only up to their length),
+  // after which at() just copies out of those arrays with no ROOT I/O. Only
+  // meant for small, hot trees (calibration tables, muon lists, ...); check
+  // snapshotBytes() first.
+  size_t snapshotBytes();
+  void snapshot();
+  bool isSnapshot() const { return snapshotted_; }
+
+  // Call after init() with a shared_ptr, which keeps the tree alive for the
+  // monitor (a TFile* may be closed under us). The owner writes the stats out
+  // (e.g. in finalize).
+  void enableIOStats(const char* name);
+  IOStats ioStats() const;
+  void writeIOStats(TDirectory& dir) const;
+
   TreeT data;
 
 protected:
   BranchManager mgr {BranchManager::IOMode::IN};
+
+private:
+  std::shared_ptr<TFile> file_;
+  std::unique_ptr<IOMonitor> ioMonitor_; // after file_, so it's destroyed first
+  std::unique_ptr<FlatFile> flat_;
+
+  struct SnapColumn {
+    std::string name;
+    void* addr;                 // in `data`
+    size_t size;                // bytes per entry (capacity, for BR_VARLEN)
+    size_t elemSize;            // BR_VARLEN only
+    int lenColumn = -1;         // BR_VARLEN only: index of its length
+    std::vector<char> bytes;
+    std::vector<size_t> offsets; // BR_VARLEN only: of each entry, plus the end
+  };
+
+  std::vector<SnapColumn> snapColumns();
+  static size_t varlenBytes(const SnapColumn& col, const std::vector<SnapColumn>& cols);
+
+  std::vector<SnapColumn> snap_;
+  size_t snapEntries_ = 0;
+  bool snapshotted_ = false;
 };
 
 template <class TreeT>
@@ -30,24 +83,87 @@ DirectReader<TreeT>::DirectReader(TFile* file, const char* treeName)
 template <class TreeT>
 void DirectReader<TreeT>::init(TFile* file, const char* treeName)
 {
+  ioMonitor_.reset();           // while its tree is still around
+
   auto tree = dynamic_cast<TTree*>(file->Get(treeName));
   tree->SetMakeClass(true);
   tree->SetBranchStatus("*", false);
+  mgr.mode = BranchManager::IOMode::IN;
   mgr.tree = tree;
   data.setManager(&mgr);
   data.initBranches();
+
+  file_.reset();                // init(shared_ptr) sets it after this
+  flat_.reset();
+  snap_.clear();
+  snapshotted_ = false;
+}
+
+template <class TreeT>
+DirectReader<TreeT>::DirectReader(std::shared_ptr<TFile> file, const char* treeName)
+{
+  init(std::move(file), treeName);
+}
+
+template <class TreeT>
+void DirectReader<TreeT>::init(std::shared_ptr<TFile> file, const char* treeName)
+{
+  init(file.get(), treeName);
+  file_ = std::move(file);
+}
+
+template <class TreeT>
+void DirectReader<TreeT>::initFlat(const char* flatPath)
+{
+  flat_ = std::make_unique<FlatFile>(flatPath);
+
+  mgr.mode = BranchManager::IOMode::LAYOUT;
+  mgr.columns.clear();
+  data.setManager(&mgr);
+  data.initBranches();
+  flat_->bind(mgr.columns);
+
+  snap_.clear();
+  snapshotted_ = false;
 }
 
 template <class TreeT>
 size_t DirectReader<TreeT>::size()
 {
+  if (snapshotted_)
+    return snapEntries_;
+
+  if (flat_)
+    return flat_->size();
+
   return mgr.tree->GetEntries();
 }
 
 template <class TreeT>
 void DirectReader<TreeT>::loadEntry(size_t entry)
 {
-  mgr.tree->GetEntry(entry);
+  if (snapshotted_) {
+    if (entry >= snapEntries_)
+      throw std::runtime_error(TmpStr("DirectReader: entry %zu out of range (%zu entries)",
+                                      entry, snapEntries_));
+    for (const auto& col : snap_) {
+      if (col.lenColumn < 0)
+        memcpy(col.addr, col.bytes.data() + entry * col.size, col.size);
+      else
+        memcpy(col.addr, col.bytes.data() + col.offsets[entry],
+               col.offsets[entry + 1] - col.offsets[entry]);
+    }
+  }
+  else if (flat_)
+    flat_->load(entry);
+  else if (!ioMonitor_)
+    mgr.tree->GetEntry(entry);
+  else {
+    const auto start = std::chrono::steady_clock::now();
+    mgr.tree->GetEntry(entry);
+    const std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    ioMonitor_->afterRead(took.count(), false);
+  }
 }
 
 template <class TreeT>
@@ -56,3 +172,164 @@ const TreeT& DirectReader<TreeT>::at(size_t entry)
   loadEntry(entry);
   return data;
 }
+
+template <class TreeT>
+void DirectReader<TreeT>::enableIOStats(const char* name)
+{
+  if (flat_)
+    return;
+  if (!file_)
+    throw std::runtime_error(TmpStr("DirectReader: IO stats for %s need the file as a shared_ptr",
+                                    name));
+  ioMonitor_ = std::make_unique<IOMonitor>(name, mgr.tree);
+}
+
+template <class TreeT>
+IOStats DirectReader<TreeT>::ioStats() const
+{
+  return ioMonitor_ ? ioMonitor_->stats() : IOStats();
+}
+
+template <class TreeT>
+void DirectReader<TreeT>::writeIOStats(TDirectory& dir) const
+{
+  if (ioMonitor_)
+    ioMonitor_->write(dir);
+}
+
+// Where each registered branch lives in `data`, from a LAYOUT pass
+template <class TreeT>
+auto DirectReader<TreeT>::snapColumns() -> std::vector<SnapColumn>
+{
+  BranchManager layout(BranchManager::IOMode::LAYOUT);
+  data.setManager(&layout);
+  data.initBranches();
+  data.setManager(&mgr);
+
+  std::vector<SnapColumn> cols;
+  for (const auto& c : layout.columns)
+    cols.push_back({c.name, c.addr, c.size, c.elemSize});
+
+  for (size_t i = 0; i < cols.size(); ++i) {
+    const auto& lenBranch = layout.columns[i].lenBranch;
+    if (lenBranch.empty())
+      continue;
+
+    const auto len = std::find_if(cols.begin(), cols.end(),
+                                  [&](const SnapColumn& c) { return c.name == lenBranch; });
+    if (len == cols.end())
+      throw std::runtime_error(TmpStr("DirectReader: length %s of %s isn't a branch",
+                                      lenBranch.c_str(), cols[i].name.c_str()));
+    cols[i].lenColumn = len - cols.begin();
+  }
+
+  return cols;
+}
+
+// Bytes of a BR_VARLEN column's current entry in `data`, per its length
+template <class TreeT>
+size_t DirectReader<TreeT>::varlenBytes(const SnapColumn& col,
+                                        const std::vector<SnapColumn>& cols)
+{
+  const SnapColumn& len = cols[col.lenColumn];
+  uint64_t n = 0;
+  switch (len.size) {
+  case 1: n = *static_cast<const uint8_t*>(len.addr); break;
+  case 2: n = *static_cast<const uint16_t*>(len.addr); break;
+  case 4: n = *static_cast<const uint32_t*>(len.addr); break;
+  case 8: n = *static_cast<const uint64_t*>(len.addr); break;
+  default:
+    throw std::runtime_error(TmpStr("DirectReader: length %s isn't an integer",
+                                    len.name.c_str()));
+  }
+
+  return std::min<uint64_t>(n * col.elemSize, col.size);
+}
+
+// What snapshot() will hold. With BR_VARLEN branches, that takes a pass over
+// the entries, reading only the length branches from a TTree.
+template <class TreeT>
+size_t DirectReader<TreeT>::snapshotBytes()
+{
+  if (snapshotted_) {
+    size_t bytes = 0;
+    for (const auto& col : snap_)
+      bytes += col.bytes.size() + col.offsets.size() * sizeof(size_t);
+    return bytes;
+  }
+
+  const auto cols = snapColumns();
+  const size_t n = size();
+
+  size_t bytes = 0;
+  bool varlen = false;
+  for (const auto& col : cols) {
+    if (col.lenColumn < 0)
+      bytes += n * col.size;
+    else {
+      bytes += (n + 1) * sizeof(size_t);
+      varlen = true;
+    }
+  }
+  if (!varlen)
+    return bytes;
+
+  if (!flat_) {
+    mgr.tree->SetBranchStatus("*", false);
+    for (const auto& col : cols)
+      if (col.lenColumn >= 0)
+        mgr.tree->SetBranchStatus(cols[col.lenColumn].name.c_str(), true);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    if (flat_)
+      flat_->load(i);
+    else
+      mgr.tree->GetEntry(i);
+    for (const auto& col : cols)
+      if (col.lenColumn >= 0)
+        bytes += varlenBytes(col, cols);
+  }
+
+  if (!flat_)
+    for (const auto& col : cols)
+      mgr.tree->SetBranchStatus(col.name.c_str(), true);
+
+  return bytes;
+}
+
+template <class TreeT>
+void DirectReader<TreeT>::snapshot()
+{
+  if (snapshotted_)
+    return;
+
+  auto cols = snapColumns();
+  const size_t n = size();
+
+  for (auto& col : cols) {
+    if (col.lenColumn < 0) {
+      col.bytes.resize(n * col.size);
+    } else {
+      col.offsets.reserve(n + 1);
+      col.offsets.push_back(0);
+    }
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    loadEntry(i);
+    for (auto& col : cols) {
+      const char* src = static_cast<const char*>(col.addr);
+      if (col.lenColumn < 0) {
+        memcpy(col.bytes.data() + i * col.size, src, col.size);
+      } else {
+        col.bytes.insert(col.bytes.end(), src, src + varlenBytes(col, cols));
+        col.offsets.push_back(col.bytes.size());
+      }
+    }
+  }
+
+  snap_ = std::move(cols);
+  snapEntries_ = n;
+  snapshotted_ = true;
+}
@@ -0,0 +1,144 @@
+#include "EntryList.hh"
+
+#include "Checkpoint.hh"
+#include "Strings.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+static constexpr char BITMAP_MAGIC[8] = {'S', 'F', 'B', 'I', 'T', 'M', 'A', 'P'};
+
+EntryBitmap::EntryBitmap(size_t nEntries) :
+  words_((nEntries + WORD_BITS - 1) / WORD_BITS),
+  nBits_(nEntries) {}
+
+void EntryBitmap::set(size_t entry)
+{
+  if (entry >= nBits_) {
+    nBits_ = entry + 1;
+    words_.resize((nBits_ + WORD_BITS - 1) / WORD_BITS);
+  }
+  words_[entry / WORD_BITS] |= uint64_t(1) << (entry % WORD_BITS);
+}
+
+// Skips over empty words 64 entries at a time, so very sparse lists are cheap
+size_t EntryBitmap::next(size_t from) const
+{
+  if (from >= nBits_)
+    return npos;
+
+  size_t iWord = from / WORD_BITS;
+  uint64_t word = words_[iWord] & (~uint64_t(0) << (from % WORD_BITS));
+
+  while (word == 0) {
+    if (++iWord == words_.size())
+      return npos;
+    word = words_[iWord];
+  }
+
+  return iWord * WORD_BITS + __builtin_ctzll(word);
+}
+
+size_t EntryBitmap::count() const
+{
+  size_t n = 0;
+  for (const auto w : words_)
+    n += __builtin_popcountll(w);
+  return n;
+}
+
+size_t EntryBitmap::count(size_t first, size_t last) const
+{
+  last = std::min(last, nBits_);
+
+  size_t n = 0;
+  for (size_t i = first; i < last; ) {
+    const size_t bit = i % WORD_BITS;
+    const size_t nHere = std::min(WORD_BITS - bit, last - i);
+    uint64_t word = words_[i / WORD_BITS] >> bit;
+    if (nHere < WORD_BITS)
+      word &= (uint64_t(1) << nHere) - 1;
+    n += __builtin_popcountll(word);
+    i += nHere;
+  }
+  return n;
+}
+
+void EntryBitmap::save(const char* path) const
+{
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  if (!ofs)
+    throw std::runtime_error(TmpStr("Couldn't write %s", path));
+
+  const uint64_t nBits = nBits_;
+  ofs.write(BITMAP_MAGIC, sizeof BITMAP_MAGIC);
+  ofs.write(reinterpret_cast<const char*>(&nBits), sizeof nBits);
+  ofs.write(reinterpret_cast<const char*>(words_.data()),
+            words_.size() * sizeof(uint64_t));
+
+  if (!ofs)
+    throw std::runtime_error(TmpStr("Failed writing %s", path));
+}
+
+EntryBitmap EntryBitmap::load(const char* path)
+{
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs)
+    throw std::runtime_error(TmpStr("Couldn't open %s", path));
+
+  char magic[sizeof BITMAP_MAGIC];
+  uint64_t nBits = 0;
+  ifs.read(magic, sizeof magic);
+  ifs.read(reinterpret_cast<char*>(&nBits), sizeof nBits);
+
+  if (!ifs || !std::equal(magic, magic + sizeof magic, BITMAP_MAGIC))
+    throw std::runtime_error(TmpStr("%s is not an entry bitmap", path));
+
+  EntryBitmap bitmap(nBits);
+  ifs.read(reinterpret_cast<char*>(bitmap.words_.data()),
+           bitmap.words_.size() * sizeof(uint64_t));
+
+  if (!ifs)
+    throw std::runtime_error(TmpStr("%s is truncated", path));
+
+  return bitmap;
+}
+
+void EntryBitmap::saveState(StateWriter& w) const
+{
+  w.put(nBits_);
+  w.put(words_);
+}
+
+void EntryBitmap::loadState(StateReader& r)
+{
+  r.get(nBits_);
+  r.get(words_);
+}
+
+EntryBitmap EntryBitmap::fromEntryList(TEntryList& list, TChain& chain)
+{
+  EntryBitmap bitmap;
+  TEntryList* prev = chain.GetEntryList();
+
+  // GetEntryNumber maps the list's i'th entry to a global chain entry
+  chain.SetEntryList(&list);
+  const Long64_t n = list.GetN();
+  for (Long64_t i = 0; i < n; ++i) {
+    const Long64_t entry = chain.GetEntryNumber(i);
+    if (entry >= 0)
+      bitmap.set(entry);
+  }
+  chain.SetEntryList(prev);
+
+  return bitmap;
+}
+
+TEntryList* EntryBitmap::toEntryList(TChain& chain) const
+{
+  auto list = new TEntryList;
+  for (size_t e = next(0); e != npos; e = next(e + 1))
+    list->Enter(e, &chain);
+  return list;
+}
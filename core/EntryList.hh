@@ -0,0 +1,52 @@
+#pragma once
+
+#include <TChain.h>
+#include <TEntryList.h>
+
+#include <cstdint>
+#include <vector>
+
+class StateReader;
+class StateWriter;
+
+// Compact set of selected (global) chain entries, one bit per entry. Used for
+// sparse reading in SyncReader. Can be saved to/loaded from a small binary
+// file, or built from a TEntryList.
+class EntryBitmap {
+public:
+  static constexpr size_t npos = size_t(-1);
+
+  EntryBitmap(size_t nEntries = 0);
+
+  void set(size_t entry);
+  bool test(size_t entry) const;
+  size_t next(size_t from) const; // first selected entry >= from, or npos
+  size_t size() const { return nBits_; }
+  size_t count() const;
+  size_t count(size_t first, size_t last) const; // in [first, last)
+
+  void save(const char* path) const;
+  static EntryBitmap load(const char* path);
+  static EntryBitmap fromEntryList(TEntryList& list, TChain& chain);
+
+  // For checkpointing the owner (see Node::saveState)
+  void saveState(StateWriter& w) const;
+  void loadState(StateReader& r);
+
+  // For attaching to a chain so that TTreeCache skips unselected clusters
+  TEntryList* toEntryList(TChain& chain) const;
+
+private:
+  static constexpr size_t WORD_BITS = 64;
+
+  std::vector<uint64_t> words_;
+  size_t nBits_ = 0;
+};
+
+inline
+bool EntryBitmap::test(size_t entry) const
+{
+  if (entry >= nBits_)
+    return false;
+  return (words_[entry / WORD_BITS] >> (entry % WORD_BITS)) & 1;
+}
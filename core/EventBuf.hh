@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Checkpoint.hh"
 #include "Kernel.hh"
 #include "RingBuf.hh"
 #include "SimpleAlg.hh"
@@ -14,6 +15,9 @@ public:
 
   Algorithm::Status consume(const Data& data) override;
   void postExecute() override;
+  bool carriesState() const override { return true; }
+  void saveState(StateWriter& w) const override;
+  void loadState(StateReader& r) override;
 
   void resize(size_t N);
 
@@ -115,6 +119,21 @@ void EventBuf<RT, TagT>::postExecute()
   ready_ = false;
 }
 
+// Between cycles, so nothing is ready
+template <class RT, class TagT>
+void EventBuf<RT, TagT>::saveState(StateWriter& w) const
+{
+  w.put(buf_);
+  w.put(pending_);
+}
+
+template <class RT, class TagT>
+void EventBuf<RT, TagT>::loadState(StateReader& r)
+{
+  r.get(buf_);
+  r.get(pending_);
+}
+
 // ----------------------------------------------------------------------
 
 // XXX Need to extract BaseSimpleAlg from SimpleAlg
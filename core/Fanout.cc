@@ -0,0 +1,146 @@
+#include "Fanout.hh"
+
+#include "Strings.hh"
+
+#include <TFileMerger.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+// Runs in the child. Reports the "requested\tactual" output paths through fd.
+static void runWorker(int id, const std::vector<std::string>& files,
+                      const PipelineSetup& setup, int fd)
+{
+  std::string manifest;
+
+  {
+    Pipeline p;
+    p.setWorkerId(id);
+    setup(p);
+    if (const std::string problem = p.slicingProblem(); !problem.empty())
+      throw std::runtime_error(problem);
+    p.process(files);
+
+    for (const auto& [requested, actual] : p.outFilePaths())
+      manifest += requested + "\t" + actual + "\n";
+  }                             // outputs get written/closed here
+
+  const char* buf = manifest.data();
+  size_t left = manifest.size();
+  while (left > 0) {
+    const ssize_t n = write(fd, buf, left);
+    if (n <= 0)
+      break;
+    buf += n;
+    left -= n;
+  }
+}
+
+static std::string readAll(int fd)
+{
+  std::string result;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof buf)) > 0)
+    result.append(buf, n);
+  return result;
+}
+
+void mergeOutputs(const std::string& outPath, const std::vector<std::string>& parts,
+                  bool removeParts)
+{
+  TFileMerger merger(false);
+  merger.OutputFile(outPath.c_str(), "RECREATE");
+  for (const auto& part : parts)
+    merger.AddFile(part.c_str());
+
+  if (!merger.Merge())
+    throw std::runtime_error(TmpStr("Failed to merge into %s", outPath.c_str()));
+
+  if (removeParts)
+    for (const auto& part : parts)
+      std::remove(part.c_str());
+}
+
+void runForked(size_t nWorkers, const std::vector<std::string>& inFiles,
+               const PipelineSetup& setup)
+{
+  nWorkers = std::max<size_t>(1, std::min(nWorkers, inFiles.size()));
+
+  struct Worker {
+    pid_t pid;
+    int fd;
+  };
+  std::vector<Worker> workers;
+
+  std::cout.flush();            // don't duplicate buffered output in children
+  fflush(stdout);
+
+  for (size_t i = 0; i < nWorkers; ++i) {
+    const auto begin = inFiles.begin() + i * inFiles.size() / nWorkers;
+    const auto end = inFiles.begin() + (i + 1) * inFiles.size() / nWorkers;
+
+    int fds[2];
+    if (pipe(fds) != 0)
+      throw std::runtime_error("runForked: pipe() failed");
+
+    const pid_t pid = fork();
+    if (pid < 0)
+      throw std::runtime_error("runForked: fork() failed");
+
+    if (pid == 0) {
+      close(fds[0]);
+      int status = 0;
+      try {
+        runWorker(i, {begin, end}, setup, fds[1]);
+      } catch (const std::exception& e) {
+        std::cerr << "Worker " << i << ": " << e.what() << std::endl;
+        status = 1;
+      }
+      close(fds[1]);
+      fflush(stdout);
+      _exit(status);            // skip the parent's static destructors
+    }
+
+    close(fds[1]);
+    workers.push_back({pid, fds[0]});
+  }
+
+  // requested path -> worker outputs, in worker order
+  std::map<std::string, std::vector<std::string>> parts;
+  size_t nFailed = 0;
+
+  for (const auto& w : workers) {
+    const std::string manifest = readAll(w.fd);
+    close(w.fd);
+
+    int status;
+    waitpid(w.pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      ++nFailed;
+      continue;
+    }
+
+    size_t pos = 0;
+    while (pos < manifest.size()) {
+      const auto tab = manifest.find('\t', pos);
+      const auto eol = manifest.find('\n', tab);
+      parts[manifest.substr(pos, tab - pos)].push_back(
+        manifest.substr(tab + 1, eol - tab - 1));
+      pos = eol + 1;
+    }
+  }
+
+  if (nFailed)
+    throw std::runtime_error(TmpStr("runForked: %zu of %zu workers failed",
+                                    nFailed, workers.size()));
+
+  for (const auto& [outPath, workerPaths] : parts)
+    mergeOutputs(outPath, workerPaths);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Kernel.hh"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using PipelineSetup = std::function<void(Pipeline&)>;
+
+// Forks nWorkers processes, each of which builds a Pipeline with setup() and
+// processes a contiguous slice of inFiles. Each worker writes its outputs to
+// "foo.w<i>.root" (see Pipeline::setWorkerId). Once all workers are done,
+// those files are merged into the "foo.root" that a single process would have
+// written: histograms are summed and trees are concatenated in file order.
+//
+// Algorithms that carry state across files (e.g. a muon buffer) would see a
+// gap at each slice boundary, so such pipelines are refused unless setup()
+// calls Pipeline::allowStatefulSlices(). Call this before opening any ROOT
+// files in the parent process.
+void runForked(size_t nWorkers, const std::vector<std::string>& inFiles,
+               const PipelineSetup& setup);
+
+// hadd-style merge of `parts` into `outPath`; removes the parts if asked
+void mergeOutputs(const std::string& outPath, const std::vector<std::string>& parts,
+                  bool removeParts = true);
@@ -0,0 +1,83 @@
+#include "FilePool.hh"
+
+#include "Strings.hh"
+
+#include <TFile.h>
+
+#include <iterator>
+#include <stdexcept>
+
+std::shared_ptr<TFile> FilePool::get(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto it = files_.find(path);
+  if (it != files_.end()) {
+    lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+    return it->second.file;
+  }
+
+  // Released, but someone outside still has it open
+  const auto rel = released_.find(path);
+  if (rel != released_.end()) {
+    if (auto file = rel->second.lock())
+      return file;
+    released_.erase(rel);
+  }
+
+  std::shared_ptr<TFile> file(TFile::Open(path.c_str()));
+  if (!file || file->IsZombie())
+    throw std::runtime_error(TmpStr("FilePool: can't open %s", path.c_str()));
+
+  lru_.push_front(path);
+  files_[path] = {file, lru_.begin()};
+  evict();
+
+  return file;
+}
+
+void FilePool::release(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto it = files_.find(path);
+  if (it == files_.end())
+    return;
+
+  if (it->second.file.use_count() > 1)
+    released_[path] = it->second.file;
+
+  lru_.erase(it->second.lruPos);
+  files_.erase(it);
+
+  for (auto rel = released_.begin(); rel != released_.end(); )
+    rel = rel->second.expired() ? released_.erase(rel) : std::next(rel);
+}
+
+void FilePool::setMaxOpen(size_t n)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  maxOpen_ = n;
+  evict();
+}
+
+size_t FilePool::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return files_.size();
+}
+
+// Oldest first; skip files that someone outside the pool still holds
+void FilePool::evict()
+{
+  auto pos = lru_.end();
+  while (files_.size() > maxOpen_ && pos != lru_.begin()) {
+    --pos;
+    const auto it = files_.find(*pos);
+    if (it->second.file.use_count() > 1)
+      continue;
+
+    files_.erase(it);
+    pos = lru_.erase(pos);
+  }
+}
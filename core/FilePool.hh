@@ -0,0 +1,49 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class TFile;
+
+// Shared, bounded set of open input files. Everyone asking for the same path
+// gets the same TFile, and the handle stays open for as long as anyone holds
+// the shared_ptr. The pool itself keeps up to maxOpen files open for reuse;
+// beyond that, the least recently used files that nobody else holds are
+// closed. Files that are still held are never closed, so the cap can be
+// exceeded temporarily.
+class FilePool {
+  static constexpr size_t DEFAULT_MAX_OPEN = 100;
+
+public:
+  FilePool(size_t maxOpen = DEFAULT_MAX_OPEN) : maxOpen_(maxOpen) {}
+  FilePool(const FilePool&) = delete;
+  FilePool& operator=(const FilePool&) = delete;
+
+  std::shared_ptr<TFile> get(const std::string& path);
+
+  // The pool stops caching `path` (e.g. every reader is done with it); it gets
+  // closed once the last outside holder lets go. Until then, get() still
+  // hands out that same TFile.
+  void release(const std::string& path);
+
+  void setMaxOpen(size_t n);
+  size_t maxOpen() const { return maxOpen_; }
+  size_t size() const;          // cached (not necessarily all open) files
+
+private:
+  struct Entry {
+    std::shared_ptr<TFile> file;
+    std::list<std::string>::iterator lruPos;
+  };
+
+  void evict();
+
+  size_t maxOpen_;
+  std::list<std::string> lru_;  // most recently used first
+  std::unordered_map<std::string, Entry> files_;
+  std::unordered_map<std::string, std::weak_ptr<TFile>> released_; // maybe still held
+  mutable std::mutex mutex_;
+};
@@ -0,0 +1,49 @@
+#include "FilePrefetcher.hh"
+
+#include <TFile.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+static void adviseWillNeed(const std::string& path, off_t headBytes, off_t tailBytes)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;                     // TChain will complain soon enough
+
+  struct stat st;
+  if (fstat(fd, &st) == 0) {
+    const off_t size = st.st_size;
+    posix_fadvise(fd, 0, std::min(size, headBytes), POSIX_FADV_WILLNEED);
+    if (size > headBytes)
+      posix_fadvise(fd, std::max(headBytes, size - tailBytes), 0, POSIX_FADV_WILLNEED);
+  }
+
+  close(fd);
+}
+
+FilePrefetcher::~FilePrefetcher()
+{
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void FilePrefetcher::prefetch(const std::string& path)
+{
+  if (!done_.insert(path).second)
+    return;
+
+  if (path.find("://") != std::string::npos) {
+    TFile::AsyncOpen(path.c_str());
+    return;
+  }
+
+  // At most one at a time; normally the previous one finished long ago
+  if (thread_.joinable())
+    thread_.join();
+
+  thread_ = std::thread(adviseWillNeed, path, off_t(headBytes_), off_t(TAIL_BYTES));
+}
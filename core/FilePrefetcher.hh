@@ -0,0 +1,30 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <thread>
+
+// Gets an input file ready before a chain switches to it, so that the switch
+// doesn't stall on opening it. URLs are opened with TFile::AsyncOpen, which
+// TFile::Open (and hence TChain) picks up when it gets there. For local
+// files, a background thread asks the kernel to read the start of the file
+// (header and first baskets) and its end (keys and streamer info) into the
+// page cache. Each file is only prefetched once.
+class FilePrefetcher {
+  static constexpr size_t DEFAULT_HEAD_BYTES = 32 << 20;
+  static constexpr size_t TAIL_BYTES = 4 << 20;
+
+public:
+  FilePrefetcher() = default;
+  FilePrefetcher(const FilePrefetcher&) = delete;
+  FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+  ~FilePrefetcher();
+
+  void prefetch(const std::string& path);
+  void setHeadBytes(size_t n) { headBytes_ = n; }
+
+private:
+  size_t headBytes_ = DEFAULT_HEAD_BYTES;
+  std::set<std::string> done_;
+  std::thread thread_;
+};
@@ -0,0 +1,230 @@
+#include "FlatFile.hh"
+
+#include "Strings.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// File layout (all integers are native-endian uint64):
+//
+//   magic[8] nEntries nColumns nFiles
+//   nColumns x { size offset nameLen name[nameLen, padded to 8] }
+//   nFiles x fileStart
+//   (pad to page) column data, each column page-aligned
+
+static constexpr char FLAT_MAGIC[8] = {'S', 'F', 'F', 'L', 'A', 'T', '0', '1'};
+static constexpr size_t PAGE = 4096;
+
+static size_t roundUp(size_t n, size_t align)
+{
+  return (n + align - 1) / align * align;
+}
+
+static void put64(std::vector<char>& buf, uint64_t val)
+{
+  const char* p = reinterpret_cast<const char*>(&val);
+  buf.insert(buf.end(), p, p + sizeof val);
+}
+
+static void writeAll(int fd, const char* data, size_t n, size_t offset,
+                     const std::string& path)
+{
+  while (n > 0) {
+    const ssize_t written = pwrite(fd, data, n, offset);
+    if (written < 0)
+      throw std::runtime_error(TmpStr("Failed writing %s: %s",
+                                      path.c_str(), strerror(errno)));
+    data += written;
+    offset += written;
+    n -= written;
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+FlatWriter::FlatWriter(const char* path, const BranchManager::Columns& columns,
+                       size_t nEntries, const std::vector<size_t>& fileStarts) :
+  path_(path), columns_(columns), nEntries_(nEntries)
+{
+  fd_ = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0)
+    throw std::runtime_error(TmpStr("Couldn't create %s", path));
+
+  std::vector<char> header(FLAT_MAGIC, FLAT_MAGIC + sizeof FLAT_MAGIC);
+  put64(header, nEntries);
+  put64(header, columns.size());
+  put64(header, fileStarts.size());
+
+  // We need the header size before we can place the columns
+  size_t headerSize = header.size();
+  for (const auto& col : columns)
+    headerSize += 3 * sizeof(uint64_t) + roundUp(col.name.size(), 8);
+  headerSize += fileStarts.size() * sizeof(uint64_t);
+
+  size_t offset = roundUp(headerSize, PAGE);
+  for (const auto& col : columns) {
+    dataOffsets_.push_back(offset);
+    offset += roundUp(nEntries * col.size, PAGE);
+
+    put64(header, col.size);
+    put64(header, dataOffsets_.back());
+    put64(header, col.name.size());
+    header.insert(header.end(), col.name.begin(), col.name.end());
+    header.resize(roundUp(header.size(), 8), '\0');
+
+    chunks_.emplace_back(CHUNK_ENTRIES * col.size);
+  }
+
+  for (const auto start : fileStarts)
+    put64(header, start);
+
+  writeAll(fd_, header.data(), header.size(), 0, path_);
+
+  if (ftruncate(fd_, offset) != 0)
+    throw std::runtime_error(TmpStr("Couldn't resize %s", path));
+}
+
+FlatWriter::~FlatWriter()
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+void FlatWriter::fill()
+{
+  if (nFilled_ + nBuffered_ >= nEntries_)
+    throw std::runtime_error(TmpStr("Too many entries for %s", path_.c_str()));
+
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    const auto& col = columns_[i];
+    memcpy(&chunks_[i][nBuffered_ * col.size], col.addr, col.size);
+  }
+
+  if (++nBuffered_ == CHUNK_ENTRIES)
+    flush();
+}
+
+void FlatWriter::flush()
+{
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    const size_t size = columns_[i].size;
+    writeAll(fd_, chunks_[i].data(), nBuffered_ * size,
+             dataOffsets_[i] + nFilled_ * size, path_);
+  }
+
+  nFilled_ += nBuffered_;
+  nBuffered_ = 0;
+}
+
+void FlatWriter::close()
+{
+  flush();
+
+  if (nFilled_ != nEntries_)
+    throw std::runtime_error(TmpStr("%s: expected %zu entries, got %zu",
+                                    path_.c_str(), nEntries_, nFilled_));
+
+  ::close(fd_);
+  fd_ = -1;
+}
+
+// -----------------------------------------------------------------------------
+
+FlatFile::FlatFile(const char* path) :
+  path_(path)
+{
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error(TmpStr("Couldn't open %s", path));
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error(TmpStr("Couldn't stat %s", path));
+  }
+  length_ = st.st_size;
+
+  void* p = mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED)
+    throw std::runtime_error(TmpStr("Couldn't mmap %s", path));
+  base_ = static_cast<char*>(p);
+
+  size_t pos = 0;
+  auto get64 = [&]() {
+    if (pos + sizeof(uint64_t) > length_)
+      throw std::runtime_error(TmpStr("%s is truncated", path));
+    uint64_t val;
+    memcpy(&val, base_ + pos, sizeof val);
+    pos += sizeof val;
+    return val;
+  };
+
+  if (length_ < sizeof FLAT_MAGIC || memcmp(base_, FLAT_MAGIC, sizeof FLAT_MAGIC) != 0)
+    throw std::runtime_error(TmpStr("%s is not a flat file", path));
+  pos += sizeof FLAT_MAGIC;
+
+  nEntries_ = get64();
+  const size_t nColumns = get64();
+  const size_t nFiles = get64();
+
+  for (size_t i = 0; i < nColumns; ++i) {
+    StoredColumn col;
+    col.size = get64();
+    col.offset = get64();
+    const size_t nameLen = get64();
+    if (pos + nameLen > length_ || col.offset + nEntries_ * col.size > length_)
+      throw std::runtime_error(TmpStr("%s is truncated", path));
+    col.name.assign(base_ + pos, nameLen);
+    pos += roundUp(nameLen, 8);
+    stored_.push_back(std::move(col));
+  }
+
+  for (size_t i = 0; i < nFiles; ++i)
+    fileStarts_.push_back(get64());
+}
+
+FlatFile::~FlatFile()
+{
+  if (base_)
+    munmap(base_, length_);
+}
+
+size_t FlatFile::fileOf(size_t entry) const
+{
+  const auto it = std::upper_bound(fileStarts_.begin(), fileStarts_.end(), entry);
+  return it == fileStarts_.begin() ? 0 : it - fileStarts_.begin() - 1;
+}
+
+void FlatFile::bind(const BranchManager::Columns& columns)
+{
+  bindings_.clear();
+
+  for (const auto& col : columns) {
+    const auto it = std::find_if(stored_.begin(), stored_.end(),
+                                 [&](const StoredColumn& s) {
+                                   return s.name == col.name;
+                                 });
+
+    if (it == stored_.end())
+      throw std::runtime_error(TmpStr("%s has no column %s",
+                                      path_.c_str(), col.name.c_str()));
+    if (it->size != col.size)
+      throw std::runtime_error(TmpStr("%s: column %s has size %zu, expected %zu",
+                                      path_.c_str(), col.name.c_str(),
+                                      it->size, col.size));
+
+    bindings_.push_back({base_ + it->offset, col.addr, col.size});
+  }
+}
+
+void FlatFile::adviseSequential()
+{
+  madvise(base_, length_, MADV_SEQUENTIAL);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+// Flat columnar cache of the branches declared by a TreeBase::initBranches().
+// Each column is stored uncompressed and contiguously, so reading an entry is a
+// handful of memcpy's out of an mmap'd file. Rereads of hot datasets are then
+// bounded by page-cache bandwidth rather than by ROOT decompression.
+//
+// Write one with convertToFlat<TreeT>(), then read it via
+// SyncReader::setFlatInput() or DirectReader::initFlat().
+
+#include "BaseIO.hh"
+#include "Util.hh"
+
+#include <TChain.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+class FlatWriter {
+public:
+  // fileStarts[i] is the first (global) entry of the i'th input file
+  FlatWriter(const char* path, const BranchManager::Columns& columns,
+             size_t nEntries, const std::vector<size_t>& fileStarts);
+  FlatWriter(const FlatWriter&) = delete;
+  FlatWriter& operator=(const FlatWriter&) = delete;
+  ~FlatWriter();
+
+  void fill();                  // append the current contents of the columns
+  void close();
+
+private:
+  static constexpr size_t CHUNK_ENTRIES = 4096;
+
+  void flush();
+
+  std::string path_;
+  int fd_ = -1;
+  BranchManager::Columns columns_;
+  std::vector<size_t> dataOffsets_;
+  std::vector<std::vector<char>> chunks_;
+  size_t nEntries_;
+  size_t nFilled_ = 0;
+  size_t nBuffered_ = 0;
+};
+
+class FlatFile {
+public:
+  FlatFile(const char* path);
+  FlatFile(const FlatFile&) = delete;
+  FlatFile& operator=(const FlatFile&) = delete;
+  ~FlatFile();
+
+  size_t size() const { return nEntries_; }
+  size_t fileCount() const { return fileStarts_.size(); }
+  size_t fileOf(size_t entry) const;  // index of the original input file
+
+  // Match the reader's columns (from a LAYOUT BranchManager) by name
+  void bind(const BranchManager::Columns& columns);
+  bool load(size_t entry) const;      // false if past the end
+  void adviseSequential();
+
+private:
+  struct Binding {
+    const char* src;
+    void* dst;
+    size_t size;
+  };
+
+  struct StoredColumn {
+    std::string name;
+    size_t size;
+    size_t offset;
+  };
+
+  std::string path_;
+  char* base_ = nullptr;
+  size_t length_ = 0;
+  size_t nEntries_ = 0;
+  std::vector<StoredColumn> stored_;
+  std::vector<size_t> fileStarts_;
+  std::vector<Binding> bindings_;
+};
+
+inline
+bool FlatFile::load(size_t entry) const
+{
+  if (entry >= nEntries_)
+    return false;
+
+  for (const auto& b : bindings_)
+    memcpy(b.dst, b.src + entry * b.size, b.size);
+
+  return true;
+}
+
+// Reads the given chains (same arguments as SyncReader) and writes every
+// branch declared in TreeT::initBranches() to a flat file at outPath.
+template <class TreeT, class... DataArgs>
+void convertToFlat(const std::vector<std::string>& inFiles,
+                   std::initializer_list<const char*> chainNames,
+                   const char* outPath, DataArgs&&... data_args)
+{
+  std::vector<std::unique_ptr<TChain>> chains;
+  for (const auto name : chainNames) {
+    chains.emplace_back(std::make_unique<TChain>(name));
+    util::initChain(*chains.back(), inFiles);
+    if (chains.size() > 1)
+      chains[0]->AddFriend(chains.back().get());
+  }
+
+  TreeT data(std::forward<DataArgs>(data_args)...);
+
+  BranchManager inMgr(BranchManager::IOMode::IN);
+  inMgr.tree = chains[0].get();
+  data.setManager(&inMgr);
+  data.initBranches();
+
+  BranchManager layout(BranchManager::IOMode::LAYOUT);
+  data.setManager(&layout);
+  data.initBranches();
+
+  const size_t nEntries = chains[0]->GetEntries(); // also fills tree offsets
+  const Long64_t* offsets = chains[0]->GetTreeOffset();
+  const std::vector<size_t> fileStarts(offsets, offsets + chains[0]->GetNtrees());
+
+  FlatWriter writer(outPath, layout.columns, nEntries, fileStarts);
+  for (size_t i = 0; i < nEntries; ++i) {
+    chains[0]->GetEntry(i);
+    writer.fill();
+  }
+  writer.close();
+}
@@ -0,0 +1,96 @@
+#include "IOStats.hh"
+
+#include <TDirectory.h>
+#include <TFile.h>
+#include <TParameter.h>
+#include <TTree.h>
+#include <TTreeCache.h>
+#include <TTreePerfStats.h>
+
+#include <cstring>
+
+void IOStats::write(TDirectory& dir, const char* name) const
+{
+  TDirectory::TContext ctx;
+  TDirectory* sub = dir.mkdir(name, "", true);
+  sub->cd();
+
+  TParameter<Long64_t>("bytesRead", bytesRead).Write("", TObject::kOverwrite);
+  TParameter<Long64_t>("readCalls", readCalls).Write("", TObject::kOverwrite);
+  TParameter<double>("unzipSeconds", unzipSeconds).Write("", TObject::kOverwrite);
+  TParameter<double>("cacheEfficiency", cacheEfficiency).Write("", TObject::kOverwrite);
+
+  char path[4096];
+  double openSeconds;
+  Long64_t fileBytes;
+
+  TTree tree("files", "Input files, in the order they were opened");
+  tree.Branch("path", path, "path/C");
+  tree.Branch("openSeconds", &openSeconds);
+  tree.Branch("bytesRead", &fileBytes);
+
+  for (const auto& file : files) {
+    strncpy(path, file.path.c_str(), sizeof path - 1);
+    path[sizeof path - 1] = '\0';
+    openSeconds = file.openSeconds;
+    fileBytes = file.bytesRead;
+    tree.Fill();
+  }
+
+  tree.Write("", TObject::kOverwrite);
+}
+
+// -----------------------------------------------------------------------------
+
+IOMonitor::IOMonitor(const char* name, TTree* tree) :
+  name_(name),
+  tree_(tree),
+  perf_(std::make_unique<TTreePerfStats>(name, tree)) // attaches itself
+{
+}
+
+IOMonitor::~IOMonitor()
+{
+  tree_->SetPerfStats(nullptr);
+}
+
+void IOMonitor::afterRead(double seconds, bool newFile)
+{
+  TFile* file = tree_->GetCurrentFile();
+  if (!file)
+    return;
+
+  if (newFile || files_.empty()) {
+    doneBytes_ += curBytes_;
+    doneCalls_ += curCalls_;
+    files_.push_back({file->GetName(), seconds, 0});
+  }
+
+  curBytes_ = file->GetBytesRead();
+  curCalls_ = file->GetReadCalls();
+  files_.back().bytesRead = curBytes_;
+}
+
+IOStats IOMonitor::stats() const
+{
+  IOStats s;
+  s.bytesRead = doneBytes_ + curBytes_;
+  s.readCalls = doneCalls_ + curCalls_;
+  s.unzipSeconds = perf_->GetUnzipTime();
+  s.files = files_;
+
+  // TChain moves its one TTreeCache from file to file, so this covers them all
+  if (TFile* file = tree_->GetCurrentFile())
+    if (TTreeCache* cache = tree_->GetReadCache(file))
+      s.cacheEfficiency = cache->GetEfficiency();
+
+  return s;
+}
+
+void IOMonitor::write(TDirectory& dir) const
+{
+  stats().write(dir, name_.c_str());
+
+  perf_->Finish();
+  dir.GetDirectory(name_.c_str())->WriteTObject(perf_.get(), "perf", "Overwrite");
+}
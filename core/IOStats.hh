@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Rtypes.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class TDirectory;
+class TFile;
+class TTree;
+class TTreePerfStats;
+
+// What reading a tree (or chain) has cost so far
+struct IOStats {
+  struct File {
+    std::string path;
+    double openSeconds = 0;     // open plus first entry (and its cluster)
+    Long64_t bytesRead = 0;
+  };
+
+  Long64_t bytesRead = 0;       // compressed, from disk or network
+  Long64_t readCalls = 0;
+  double unzipSeconds = 0;      // decompression
+  double cacheEfficiency = 0;   // TTreeCache::GetEfficiency: prefetched baskets used
+  std::vector<File> files;      // in the order they were opened
+
+  // Under dir/name: the totals as TParameters, plus a "files" tree
+  void write(TDirectory& dir, const char* name) const;
+};
+
+// Collects IOStats for one tree or chain. Unzip times come from ROOT's
+// TTreePerfStats, which the chain hands on to each of its trees; byte and
+// call counts are per TFile, so they're sampled after every read and summed
+// across files.
+class IOMonitor {
+public:
+  IOMonitor(const char* name, TTree* tree);
+  ~IOMonitor();
+  IOMonitor(const IOMonitor&) = delete;
+  IOMonitor& operator=(const IOMonitor&) = delete;
+
+  // Call after each GetEntry with the time it took and whether it moved to
+  // a new file
+  void afterRead(double seconds, bool newFile);
+
+  IOStats stats() const;
+  // The stats, plus the TTreePerfStats (with its per-basket graphs)
+  void write(TDirectory& dir) const;
+
+private:
+  std::string name_;
+  TTree* tree_;
+  std::unique_ptr<TTreePerfStats> perf_;
+
+  std::vector<IOStats::File> files_;
+  Long64_t doneBytes_ = 0, doneCalls_ = 0; // of files we've moved past
+  Long64_t curBytes_ = 0, curCalls_ = 0;   // of the current file
+};
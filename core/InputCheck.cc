@@ -0,0 +1,127 @@
+#include "InputCheck.hh"
+
+#include "ChainIndex.hh"
+
+#include <TFile.h>
+#include <TROOT.h>
+#include <TTree.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace {
+
+struct FileResult {
+  std::string problem;          // empty if the file is good
+  std::vector<std::pair<std::string, FileIndex>> scanned; // tree, index
+};
+
+}
+
+// Runs on the worker threads, so it only reads from the index
+static FileResult checkFile(const std::string& path,
+                            const std::vector<InputRequirement>& reqs,
+                            const ChainIndex* index)
+{
+  FileResult result;
+
+  FileIndex stamped;
+  const bool canIndex = index && ChainIndex::stamp(path, stamped);
+
+  TDirectory::TContext ctx;
+  std::unique_ptr<TFile> file(TFile::Open(path.c_str()));
+  if (!file || file->IsZombie()) {
+    result.problem = "can't open";
+    return result;
+  }
+  if (file->TestBit(TFile::kRecovered)) {
+    result.problem = "wasn't closed properly";
+    return result;
+  }
+
+  for (const auto& req : reqs) {
+    std::vector<TTree*> trees;
+    for (const auto& name : req.trees) {
+      TTree* tree = nullptr;
+      file->GetObject(name.c_str(), tree);
+      if (!tree) {
+        result.problem = "no tree " + name;
+        return result;
+      }
+      trees.push_back(tree);
+    }
+
+    std::string missing;
+    for (const auto& branch : req.branches) {
+      const bool found = std::any_of(trees.begin(), trees.end(), [&](TTree* tree) {
+        return tree->GetBranch(branch.c_str()) != nullptr;
+      });
+      if (!found)
+        missing += (missing.empty() ? "" : ", ") + branch;
+    }
+    if (!missing.empty()) {
+      result.problem = "missing branches " + missing;
+      return result;
+    }
+
+    if (!canIndex)
+      continue;
+
+    for (size_t i = 0; i < trees.size(); ++i) {
+      const std::string& name = req.trees[i];
+      const bool done = std::any_of(result.scanned.begin(), result.scanned.end(),
+                                    [&](const auto& s) { return s.first == name; });
+      if (done || index->find(path, name))
+        continue;
+
+      FileIndex idx = ChainIndex::scan(trees[i], index->secBranch(), index->nsecBranch());
+      idx.size = stamped.size;
+      idx.mtime = stamped.mtime;
+      result.scanned.emplace_back(name, std::move(idx));
+    }
+  }
+
+  return result;
+}
+
+std::vector<InputProblem> validateInputs(const std::vector<std::string>& files,
+                                         const std::vector<InputRequirement>& reqs,
+                                         size_t nThreads, ChainIndex* index)
+{
+  ROOT::EnableThreadSafety();
+
+  std::vector<FileResult> results(files.size());
+  std::atomic<size_t> next{0};
+
+  auto work = [&] {
+    for (size_t i; (i = next++) < files.size();) {
+      try {
+        results[i] = checkFile(files[i], reqs, index);
+      } catch (const std::exception& e) {
+        results[i].problem = e.what();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  const size_t n = std::max<size_t>(1, std::min(nThreads, files.size()));
+  for (size_t t = 0; t < n; ++t)
+    threads.emplace_back(work);
+  for (auto& thread : threads)
+    thread.join();
+
+  std::vector<InputProblem> problems;
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (!results[i].problem.empty())
+      problems.push_back({i, files[i], results[i].problem});
+    else if (index)
+      for (auto& [tree, idx] : results[i].scanned)
+        index->put(files[i], tree, std::move(idx));
+  }
+
+  return problems;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+class ChainIndex;
+
+// What a reader needs from every input file
+struct InputRequirement {
+  std::vector<std::string> trees;
+  std::vector<std::string> branches; // each in at least one of the trees
+};
+
+struct InputProblem {
+  size_t iFile;
+  std::string path;
+  std::string what;
+};
+
+// Open every file's header, nThreads files at a time, and check it against
+// each requirement. Returns the bad files, in order. Since the good files are
+// open anyway, their required trees also go into the index, if given.
+std::vector<InputProblem> validateInputs(const std::vector<std::string>& files,
+                                         const std::vector<InputRequirement>& reqs,
+                                         size_t nThreads, ChainIndex* index = nullptr);
@@ -1,7 +1,12 @@
 #include "Kernel.hh"
 
+#include "AlgProfiler.hh"
+#include "ChainIndex.hh"
+#include "Checkpoint.hh"
 #include "Util.hh"
 
+#include <algorithm>
+#include <iostream>
 #include <typeinfo>
 
 void Node::do_connect(Pipeline& pipeline)
@@ -17,6 +22,23 @@ int Node::rawTag() const
 
 // -----------------------------------------------------------------------------
 
+Pipeline::Pipeline() {}
+Pipeline::~Pipeline() {}
+
+void Pipeline::enableCheckpoints(const char* path, size_t everyCycles)
+{
+  if (!outFilePaths_.empty())
+    throw std::runtime_error("enableCheckpoints must be called before makeOutFile");
+
+  const std::string realPath = workerId_.empty() ? path : util::workerPath(path, workerId_);
+  checkpoint_ = std::make_unique<Checkpointer>(realPath, everyCycles);
+}
+
+bool Pipeline::resuming() const
+{
+  return checkpoint_ && checkpoint_->resuming();
+}
+
 TFile* Pipeline::makeOutFile(const char* path, const char* name, bool reopen,
                              const char* mode)
 {
@@ -28,7 +50,19 @@ TFile* Pipeline::makeOutFile(const char* path, const char* name, bool reopen,
       throw std::runtime_error(TmpStr("file %s already opened", name));
   }
 
-  const auto& ptr = outFileMap[name] = std::make_unique<TFile>(path, "RECREATE");
+  // A reopened file is still one output (and must be merged only once)
+  const std::string realPath = workerId_.empty() ? path : util::workerPath(path, workerId_);
+  const auto known = std::find_if(outFilePaths_.begin(), outFilePaths_.end(),
+                                   [&](const auto& pr) { return pr.second == realPath; });
+  if (known == outFilePaths_.end())
+    outFilePaths_.emplace_back(path, realPath);
+
+  // When resuming, keep what was written up to the checkpoint
+  const char* realMode = resuming() ? "UPDATE" : mode;
+
+  const auto& ptr = outFileMap[name] = std::make_unique<TFile>(realPath.c_str(), realMode);
+  if (resuming())
+    checkpoint_->truncateTrees(*ptr, name);
   return ptr.get();
 }
 
@@ -49,10 +83,113 @@ std::string Pipeline::inFilePath(size_t i)
 
 TFile* Pipeline::inFile(size_t i)
 {
-  const auto& path = inFilePaths.at(i);
-  if (!inFileHandles.count(path))
-    inFileHandles[path] = new TFile(path.c_str());
-  return inFileHandles[path];
+  if (parent_)
+    return parent_->inFile(i);
+
+  auto& lease = inFileLeases_[inFilePaths.at(i)];
+  if (!lease)
+    lease = inFileShared(i);
+  return lease.get();
+}
+
+std::shared_ptr<TFile> Pipeline::inFileShared(size_t i)
+{
+  if (parent_)
+    return parent_->inFileShared(i);
+
+  return filePool_.get(inFilePaths.at(i));
+}
+
+void Pipeline::setChainIndex(const char* path)
+{
+  chainIndex_ = std::make_unique<ChainIndex>(path);
+}
+
+ChainIndex* Pipeline::chainIndex()
+{
+  if (!chainIndex_ && parent_)
+    return parent_->chainIndex();
+  return chainIndex_.get();
+}
+
+void Pipeline::setInputValidation(size_t nThreads, bool dropBad)
+{
+  validationThreads_ = nThreads;
+  dropBadInputs_ = dropBad;
+}
+
+std::vector<std::string> Pipeline::checkInputs(const std::vector<std::string>& files)
+{
+  std::vector<InputRequirement> reqs;
+  for (const auto& alg : algVec)
+    for (auto& req : alg->inputRequirements())
+      reqs.push_back(std::move(req));
+
+  const auto problems = validateInputs(files, reqs, validationThreads_, chainIndex());
+  if (problems.empty())
+    return files;
+
+  for (const auto& problem : problems)
+    std::cerr << "Bad input " << problem.path << ": " << problem.what << std::endl;
+
+  if (!dropBadInputs_)
+    throw std::runtime_error(TmpStr("%zu of %zu input files are bad",
+                                    problems.size(), files.size()));
+
+  std::vector<std::string> good;
+  auto problem = problems.begin();
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (problem != problems.end() && problem->iFile == i)
+      ++problem;
+    else
+      good.push_back(files[i]);
+  }
+
+  if (good.empty())
+    throw std::runtime_error("All input files are bad");
+
+  return good;
+}
+
+bool Pipeline::carriesState() const
+{
+  auto stateful = [](const auto& node) { return node->carriesState(); };
+  return std::any_of(algVec.begin(), algVec.end(), stateful)
+    || std::any_of(toolVec.begin(), toolVec.end(), stateful);
+}
+
+std::string Pipeline::slicingProblem() const
+{
+  if (allowStatefulSlices_)
+    return "";
+
+  std::string names;
+  auto check = [&](const Node& node) {
+    if (node.carriesState())
+      names += (names.empty() ? "" : ", ") + util::demangle(typeid(node).name());
+  };
+  for (const auto& alg : algVec)
+    check(*alg);
+  for (const auto& tool : toolVec)
+    check(*tool);
+
+  if (names.empty())
+    return "";
+  return "can't split the input, since these carry state across events: " + names
+    + " (see Pipeline::allowStatefulSlices)";
+}
+
+std::vector<const Algorithm*> Pipeline::algsBefore(const Algorithm* alg) const
+{
+  std::vector<const Algorithm*> result;
+
+  for (const auto& a : algVec) {
+    if (a.get() == alg)
+      break;
+    result.push_back(a.get());
+  }
+
+  return result;
 }
 
 void Pipeline::notifyFileChanged(const Algorithm* reader, size_t i)
@@ -62,58 +199,105 @@ void Pipeline::notifyFileChanged(const Algorithm* reader, size_t i)
 
   for (const auto& tool : toolVec)
     tool->fileChanged(reader, i);
+
+  readerFiles_[reader] = i;
+  releaseFinishedFiles();
 }
 
-void Pipeline::connect(const std::vector<std::string>& inFiles)
+void Pipeline::prefetchInFile(size_t i)
 {
-  inFilePaths = inFiles;
+  if (parent_)
+    return parent_->prefetchInFile(i);
+
+  if (i < inFilePaths.size())
+    prefetcher_.prefetch(inFilePaths[i]);
+}
+
+// Files before the one that the furthest-behind running reader is on
+void Pipeline::releaseFinishedFiles()
+{
+  size_t minFile = inFilePaths.size();
+  for (const Algorithm* reader : runningReaders) {
+    const auto it = readerFiles_.find(reader);
+    minFile = std::min(minFile, it == readerFiles_.end() ? 0 : it->second);
+  }
+
+  for (; nReleasedFiles_ < minFile; ++nReleasedFiles_)
+    filePool_.release(inFilePaths[nReleasedFiles_]);
+}
+
+void Pipeline::connect(const std::vector<std::string>& allInFiles)
+{
+  inFilePaths = validationThreads_ ? checkInputs(allInFiles) : allInFiles;
+  const auto& inFiles = inFilePaths;
 
   for (const auto& alg : algVec)
     alg->load(inFiles);
 
+  if (chainIndex_)              // don't wait for the end of the job
+    chainIndex_->save();
+
   for (const auto& alg : algVec)
     alg->do_connect(*this);
 
   for (const auto& tool : toolVec)
     tool->do_connect(*this);
+
+  if (checkpoint_)
+    checkpoint_->checkNodes(*this);
+  if (resuming())
+    checkpoint_->restore(*this);
 }
 
-void Pipeline::loop()
+bool Pipeline::isDoneReader(const Algorithm* alg) const
 {
-  Algorithm* lastAlg = nullptr;
-
-  auto isDoneReader = [&](const std::unique_ptr<Algorithm>& alg) {
-    return alg->isReader() && runningReaders.count(alg.get()) == 0;
-  };
+  return alg->isReader() && runningReaders.count(alg) == 0;
+}
 
-  while (true) {
-    for (const auto& alg : algVec) {
-      if (isDoneReader(alg))
-        continue;
+void Pipeline::executeCycle()
+{
+  lastAlg_ = nullptr;
 
-      lastAlg = alg.get();
+  if (profiling_ && !profiler_)
+    profiler_ = std::make_unique<AlgProfiler>(algVec.size());
 
-      const auto status = alg->execute();
-      if (status == Algorithm::Status::SkipToNext)
-        break;
-      if (status == Algorithm::Status::EndOfFile)
-        runningReaders.erase(alg.get());
-    }
+  for (size_t i = 0; i < algVec.size(); ++i) {
+    const auto& alg = algVec[i];
+    if (isDoneReader(alg.get()))
+      continue;
 
-    for (const auto& alg : algVec) {
-      if (isDoneReader(alg))
-        continue;
+    lastAlg_ = alg.get();
 
-      alg->postExecute();
+    if (profiler_)
+      profiler_->start();
+    const auto status = alg->execute();
+    if (profiler_)
+      profiler_->stop(i);
 
-      if (alg.get() == lastAlg)
-        break;
+    if (status == Algorithm::Status::SkipToNext)
+      break;
+    if (status == Algorithm::Status::EndOfFile) {
+      runningReaders.erase(alg.get());
+      releaseFinishedFiles();
     }
+  }
+}
 
-    if (runningReaders.size() == 0)
+void Pipeline::postExecuteCycle()
+{
+  for (const auto& alg : algVec) {
+    if (isDoneReader(alg.get()))
+      continue;
+
+    alg->postExecute();
+
+    if (alg.get() == lastAlg_)
       break;
   }
+}
 
+void Pipeline::finalize()
+{
   for (const auto& alg : algVec) {
     // For convenience, cd to the default output file
     if (outFileMap.find(DefaultFile) != outFileMap.end())
@@ -121,4 +305,32 @@ void Pipeline::loop()
 
     alg->finalize(*this);
   }
+
+  results_.write(*this);
+}
+
+void Pipeline::loop()
+{
+  while (true) {
+    executeCycle();
+    postExecuteCycle();
+
+    if (runningReaders.size() == 0)
+      break;
+
+    if (checkpoint_ && checkpoint_->due())
+      checkpoint_->save(*this);
+  }
+
+  finalize();
+
+  if (profiler_) {
+    std::vector<std::string> names;
+    for (const auto& alg : algVec)
+      names.push_back(util::demangle(typeid(*alg.get()).name()));
+    profiler_->report(std::cout, names);
+  }
+
+  if (checkpoint_)
+    checkpoint_->markDone();
 }
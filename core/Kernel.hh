@@ -1,5 +1,9 @@
 #pragma once
 
+#include "FilePool.hh"
+#include "FilePrefetcher.hh"
+#include "InputCheck.hh"
+#include "Results.hh"
 #include "Strings.hh"
 
 #include <TFile.h>
@@ -10,10 +14,16 @@
 #include <stdexcept>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 class Algorithm;
+class Checkpointer;
+class AlgProfiler;
+class ChainIndex;
 class Pipeline;
+class StateReader;
+class StateWriter;
 
 
 class Node {
@@ -30,6 +40,16 @@ public:
 
   virtual void fileChanged(const Algorithm* reader, size_t iFile) {};
 
+  // Opt-in support for checkpoints (see Pipeline::enableCheckpoints). Whatever
+  // saveState writes, loadState must read back in the same order.
+  virtual void saveState(StateWriter& w) const {};
+  virtual void loadState(StateReader& r) {};
+
+  // True if what this does with an event depends on earlier events, which
+  // may be in an earlier input file (e.g. a muon veto window or a buffer).
+  // See Pipeline::slicingProblem.
+  virtual bool carriesState() const { return false; }
+
 protected:
   Pipeline& pipe() const { return *pipe_; }
 
@@ -60,13 +80,18 @@ public:
   virtual void postExecute() { };
   virtual void finalize(Pipeline& pipeline) { };
   virtual bool isReader() const { return false; } // "reader" algs need special treatment
+  // What the input files must contain (see Pipeline::setInputValidation)
+  virtual std::vector<InputRequirement> inputRequirements() { return {}; }
+  // Parameters that aren't in a Config tool but change which events pass
+  // (e.g. a cut given to the ctor); see skimCacheKey
+  virtual std::string cacheKey() const { return ""; }
 };
 
 // -----------------------------------------------------------------------------
 
 class Pipeline {
 public:
-  Pipeline() = default;
+  Pipeline();
   Pipeline(const Pipeline&) = delete;
   Pipeline& operator=(const Pipeline&) = delete;
 
@@ -91,27 +116,102 @@ public:
   template <class Tool, class T = int>
   Tool* getTool(T tag = 0);
 
+  // All matches (possibly none), in order of creation
+  template <class Tool>
+  std::vector<Tool*> getTools();
+
+  // The algorithms that run before `alg` in each cycle
+  std::vector<const Algorithm*> algsBefore(const Algorithm* alg) const;
+
   TFile* makeOutFile(const char* path, const char* name = DefaultFile, bool reopen=false,
                      const char* mode = "RECREATE");
   TFile* getOutFile(const char* name = DefaultFile);
   static constexpr const char* const DefaultFile = "";
 
+  // When set (e.g. by runForked), makeOutFile writes "foo.root" as
+  // "foo.w<id>.root" instead. outFilePaths() gives {requested, actual} pairs.
+  void setWorkerId(int id) { workerId_ = std::to_string(id); }
+  void setWorkerId(const std::string& id) { workerId_ = id; }
+  const std::string& workerId() const { return workerId_; }
+  const std::vector<std::pair<std::string, std::string>>& outFilePaths() const
+  { return outFilePaths_; }
+
+  // Splitting the input (runForked, WorkQueue) gives each slice a fresh
+  // Pipeline, so any Node that carriesState() starts cold at each slice
+  // boundary and the merged results differ from a single job's. Such
+  // pipelines are refused: slicingProblem() names the offending Nodes, or is
+  // empty if there are none or allowStatefulSlices() was called to accept
+  // the difference.
+  void allowStatefulSlices() { allowStatefulSlices_ = true; }
+  std::string slicingProblem() const;
+  bool carriesState() const;    // does any Node?
+
   size_t inFileCount();
   std::string inFilePath(size_t i = 0);
+
+  // Opened once and kept open until the Pipeline is destroyed
   TFile* inFile(size_t i = 0);
 
+  // Input files come from a shared pool (see FilePool), so hold on to the
+  // pointer for as long as you use the file or anything read from it. Once
+  // every reader has moved past a file, the pool lets go of it. The readers'
+  // TChains open their own handles, outside the pool (a TChain keeps only
+  // its current file open).
+  std::shared_ptr<TFile> inFileShared(size_t i = 0);
+  FilePool& filePool() { return filePool_; }
+
   void notifyFileChanged(const Algorithm* reader, size_t iFile);
+  // Start getting input file i ready in the background (see FilePrefetcher)
+  void prefetchInFile(size_t i);
+
+  // Readers set up their chains from (and update) the index at `path`; see
+  // ChainIndex. Must be called before connect.
+  void setChainIndex(const char* path);
+  ChainIndex* chainIndex();
+
+  // Before the readers load, open every input file's header (nThreads at a
+  // time) and check that it has the trees and branches the readers need. Bad
+  // files are reported and dropped, or, with dropBad = false, abort the job.
+  // Dropping shifts global entry numbers, so keep dropBad = false when using
+  // entry ranges or entry lists. Fills the chain index as a side effect.
+  void setInputValidation(size_t nThreads = 8, bool dropBad = true);
+
+  // Save the pipeline's state to `path` every `everyCycles` cycles. If `path`
+  // already exists (i.e. the job was interrupted), resume from it instead of
+  // starting over. Must be called before makeOutFile, which then reopens the
+  // existing outputs.
+  void enableCheckpoints(const char* path, size_t everyCycles = 100000);
+  bool checkpointing() const { return bool(checkpoint_); }
+  bool resuming() const;
+
+  // Mergeable outputs (histograms, counters, trees); written after finalize()
+  ResultSet& results() { return results_; }
+  void mergeResults(const Pipeline& other) { results_.merge(other.results_); }
 
   void connect(const std::vector<std::string>& inFiles);
   void loop();
 
+  // Measure each algorithm's execute() with hardware counters, or the wall
+  // clock if those aren't permitted (see AlgProfiler). loop() prints a
+  // summary after finalize.
+  void enableProfiling() { profiling_ = true; }
+  const AlgProfiler* profiler() const { return profiler_.get(); }
+
+  // A child pipeline (see Sweep) falls back to its parent in getAlg/getTool,
+  // so it can share the parent's readers. Children are driven cycle-by-cycle
+  // by their owner rather than by loop().
+  void setParent(Pipeline* parent) { parent_ = parent; }
+  void executeCycle();
+  void postExecuteCycle();
+  void finalize();
+
   void process(const std::vector<std::string>& inFiles)
   {
     connect(inFiles);
     loop();
   }
 
-  ~Pipeline() {};
+  ~Pipeline();
 
 private:
   template <class Thing>
@@ -121,21 +221,55 @@ private:
   Thing& makeThing(PtrVec<BaseThing>& vec, Args&&... args);
 
   template <class Thing, class BaseThing>
-  Thing* getThing(PtrVec<BaseThing>& vec, Pred<Thing> pred);
+  Thing* getThing(PtrVec<BaseThing> Pipeline::* vec, Pred<Thing> pred);
+
+  template <class Thing, class BaseThing>
+  Thing* getThing(PtrVec<BaseThing> Pipeline::* vec, int tag);
 
   template <class Thing, class BaseThing>
-  Thing* getThing(PtrVec<BaseThing>& vec, int tag);
+  std::vector<Thing*> getThings(PtrVec<BaseThing>& vec);
+
+  bool isDoneReader(const Algorithm* alg) const;
+  std::vector<std::string> checkInputs(const std::vector<std::string>& files);
+
+  // Destroyed after outFileMap, so that a finished job's checkpoint is only
+  // removed once its outputs are closed
+  std::unique_ptr<Checkpointer> checkpoint_;
+  std::unique_ptr<ChainIndex> chainIndex_;
+  std::unique_ptr<AlgProfiler> profiler_;
+  bool profiling_ = false;
 
   // Make sure outFileMap is declared BEFORE algVec/toolVec etc.
   // to ensure that files are still open during alg/tool/etc destructors
   std::map<std::string, std::unique_ptr<TFile>> outFileMap;
+  // Likewise for the files handed out by inFile()
+  std::map<std::string, std::shared_ptr<TFile>> inFileLeases_;
 
   PtrVec<Algorithm> algVec;
   std::set<const Algorithm*> runningReaders;
   PtrVec<Tool> toolVec;
 
+  void releaseFinishedFiles();
+
   std::vector<std::string> inFilePaths;
-  std::map<std::string, TFile*> inFileHandles;
+  FilePool filePool_;
+  FilePrefetcher prefetcher_;
+  std::map<const Algorithm*, size_t> readerFiles_; // current file of each reader
+  size_t nReleasedFiles_ = 0;
+
+  size_t validationThreads_ = 0; // 0 = don't validate
+  bool dropBadInputs_ = true;
+
+  ResultSet results_;
+
+  Pipeline* parent_ = nullptr;
+  Algorithm* lastAlg_ = nullptr;
+
+  std::string workerId_;        // empty: not a worker
+  std::vector<std::pair<std::string, std::string>> outFilePaths_;
+  bool allowStatefulSlices_ = false;
+
+  friend class Checkpointer;
 };
 
 template <class Thing, class BaseThing, class... Args>
@@ -143,6 +277,7 @@ Thing& Pipeline::makeThing(PtrVec<BaseThing>& vec, Args&&... args)
 {
   auto p = std::make_unique<Thing>(std::forward<Args>(args)...);
   Thing& thingRef = *p;
+  thingRef.pipe_ = this;        // reset by do_connect, but load() needs it too
   vec.push_back(std::move(p));
   return thingRef;
 }
@@ -165,11 +300,11 @@ Tool& Pipeline::makeTool(Args&&... args)
 }
 
 template <class Thing, class BaseThing>
-Thing* Pipeline::getThing(PtrVec<BaseThing>& vec, Pred<Thing> pred)
+Thing* Pipeline::getThing(PtrVec<BaseThing> Pipeline::* vec, Pred<Thing> pred)
 {
   Thing* result = nullptr;
 
-  for (const auto& pThing : vec) {
+  for (const auto& pThing : this->*vec) {
     auto &thing = *pThing;          // https://stackoverflow.com/q/46494928
     auto castedPtr = dynamic_cast<Thing*>(pThing.get());
     if (castedPtr && (!pred || pred(*castedPtr))) {
@@ -180,6 +315,9 @@ Thing* Pipeline::getThing(PtrVec<BaseThing>& vec, Pred<Thing> pred)
     }
   }
 
+  if (!result && parent_)
+    return parent_->getThing<Thing>(vec, pred);
+
   if (!result)
     throw std::runtime_error(TmpStr("getThing() couldn't find %s",
                                     typeid(Thing).name()));
@@ -188,7 +326,7 @@ Thing* Pipeline::getThing(PtrVec<BaseThing>& vec, Pred<Thing> pred)
 }
 
 template <class Thing, class BaseThing>
-Thing* Pipeline::getThing(PtrVec<BaseThing>& vec, int tag)
+Thing* Pipeline::getThing(PtrVec<BaseThing> Pipeline::* vec, int tag)
 {
   auto pred = [&](const Thing& thing) {
     return thing.rawTag() == tag;
@@ -196,28 +334,47 @@ Thing* Pipeline::getThing(PtrVec<BaseThing>& vec, int tag)
   return getThing<Thing, BaseThing>(vec, pred);
 }
 
+template <class Thing, class BaseThing>
+std::vector<Thing*> Pipeline::getThings(PtrVec<BaseThing>& vec)
+{
+  std::vector<Thing*> result;
+
+  for (const auto& pThing : vec) {
+    if (auto castedPtr = dynamic_cast<Thing*>(pThing.get()))
+      result.push_back(castedPtr);
+  }
+
+  return result;
+}
+
 template <class Alg>
 Alg* Pipeline::getAlg(Pred<Alg> pred)
 {
-  return getThing(algVec, pred);
+  return getThing(&Pipeline::algVec, pred);
 }
 
 template <class Alg, class T>
 Alg* Pipeline::getAlg(T tag)
 {
-  return getThing<Alg>(algVec, int(tag));
+  return getThing<Alg>(&Pipeline::algVec, int(tag));
 }
 
 template <class Tool>
 Tool* Pipeline::getTool(Pred<Tool> pred)
 {
-  return getThing(toolVec, pred);
+  return getThing(&Pipeline::toolVec, pred);
 }
 
 template <class Tool, class T>
 Tool* Pipeline::getTool(T tag)
 {
-  return getThing<Tool>(toolVec, int(tag));
+  return getThing<Tool>(&Pipeline::toolVec, int(tag));
+}
+
+template <class Tool>
+std::vector<Tool*> Pipeline::getTools()
+{
+  return getThings<Tool>(toolVec);
 }
 
 // -----------------------------------------------------------------------------
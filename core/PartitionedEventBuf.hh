@@ -0,0 +1,227 @@
+#pragma once
+
+#include "Checkpoint.hh"
+#include "Kernel.hh"
+#include "RingBuf.hh"
+#include "SimpleAlg.hh"
+#include "Strings.hh"
+
+#include <stdexcept>
+#include <vector>
+
+// Like EventBuf, but each event is routed (by KeyFn, a default-constructible
+// functor mapping Data -> size_t) into one of several rings, e.g. one per
+// detector. Each partition has its own capacity and enough() decision, so
+// consumers only ever walk events from the relevant partition.
+//
+// At most one event is consumed per cycle, so at most one partition releases
+// an event per cycle; partition() tells which. iter() points into that
+// partition's ring, so BufferedSimpleAlg works unchanged.
+//
+// enough(part) is only asked when an event arrives in that partition, so a
+// partition that goes quiet would hold on to its pending events. Override
+// stale() to release them on a global watermark instead: in each cycle, a
+// partition whose oldest pending event is stale() given the incoming event
+// (whichever partition that's in) is released first, since its event is the
+// older one. Partitions take turns, so a busy one can't starve the others.
+// If that stale release takes the cycle from an arrival whose partition had
+// enough(), the partition is owed a release: owed releases go out, while
+// enough() still holds, in the next cycles that release nothing else. A
+// partition whose ring is full of pending events throws rather than overwrite.
+template <class ReaderT, class KeyFn, class TagT = int>
+class PartitionedEventBuf : public SimpleAlg<ReaderT, TagT> {
+  static constexpr size_t DEFAULT_SIZE = 1000;
+
+public:
+  using Data = algdata_t<ReaderT>;
+  using Iter = typename RingBuf<Data>::iter_t;
+
+  using SimpleAlg<ReaderT, TagT>::SimpleAlg;
+
+  Algorithm::Status consume(const Data& data) override;
+  void postExecute() override;
+  bool carriesState() const override { return true; }
+  void saveState(StateWriter& w) const override;
+  void loadState(StateReader& r) override;
+
+  // Must be called (before the loop) to set the number of partitions
+  void setPartitions(size_t nParts, size_t N = DEFAULT_SIZE);
+  void resizePartition(size_t part, size_t N);
+  size_t partitions() const { return parts_.size(); }
+
+  // PartitionedEventBuf is also a Reader itself:
+  bool ready() const;
+  const Data& getData() const;
+  const Data& pending() const;
+  Iter iter() const;
+  size_t partition() const { return readyPart_; }
+
+  // Per-partition access, e.g. to scan one detector's history
+  const RingBuf<Data>& ring(size_t part) const { return parts_[part].buf; }
+  const Data& latest(size_t part) const { return parts_[part].buf.top(); }
+  size_t pendingCount(size_t part) const { return parts_[part].pending; }
+  const Data& oldestPending(size_t part) const
+  { return parts_[part].buf.at(parts_[part].pending - 1); }
+
+  virtual bool keep() const { return true; }
+  virtual bool enough(size_t part) const = 0;
+  // E.g. timeOf(newest) - timeOf(oldestPending(part)) > window
+  virtual bool stale(size_t part, const Data& newest) const { return false; }
+
+private:
+  struct Partition {
+    RingBuf<Data> buf;
+    size_t pending = 0;
+    size_t owed = 0;            // enough() releases lost to stale ones
+  };
+
+  std::vector<Partition> parts_;
+  KeyFn keyFn_;
+  size_t readyPart_ = 0;
+  size_t nextStale_ = 0;        // where the next stale() scan starts
+  bool ready_ = false;
+};
+
+template <class RT, class KeyFn, class TagT>
+void PartitionedEventBuf<RT, KeyFn, TagT>::setPartitions(size_t nParts, size_t N)
+{
+  parts_.clear();
+  parts_.reserve(nParts);
+  for (size_t i = 0; i < nParts; ++i)
+    parts_.push_back({RingBuf<Data>(N)});
+}
+
+template <class RT, class KeyFn, class TagT>
+void PartitionedEventBuf<RT, KeyFn, TagT>::resizePartition(size_t part, size_t N)
+{
+  parts_.at(part).buf.resize(N);
+  parts_[part].pending = 0;
+  parts_[part].owed = 0;
+}
+
+template <class RT, class KeyFn, class TagT>
+inline
+bool PartitionedEventBuf<RT, KeyFn, TagT>::ready() const
+{
+  return ready_;
+}
+
+template <class RT, class KeyFn, class TagT>
+inline
+const typename PartitionedEventBuf<RT, KeyFn, TagT>::Data&
+PartitionedEventBuf<RT, KeyFn, TagT>::getData() const
+{
+  return pending();
+}
+
+template <class RT, class KeyFn, class TagT>
+inline
+const typename PartitionedEventBuf<RT, KeyFn, TagT>::Data&
+PartitionedEventBuf<RT, KeyFn, TagT>::pending() const
+{
+  return *iter();
+}
+
+template <class RT, class KeyFn, class TagT>
+inline
+typename PartitionedEventBuf<RT, KeyFn, TagT>::Iter
+PartitionedEventBuf<RT, KeyFn, TagT>::iter() const
+{
+  const auto& part = parts_[readyPart_];
+  return part.buf.begin() + (part.pending - 1);
+}
+
+template <class RT, class KeyFn, class TagT>
+Algorithm::Status PartitionedEventBuf<RT, KeyFn, TagT>::consume(const Data& data)
+{
+  const bool kept = keep();
+  size_t key = 0;
+
+  if (kept) {
+    key = keyFn_(data);
+    if (key >= parts_.size())
+      throw std::runtime_error(TmpStr("PartitionedEventBuf: key %zu out of range (%zu partitions)",
+                                      key, parts_.size()));
+
+    auto& part = parts_[key];
+    if (part.buf.full() && part.pending == part.buf.size())
+      throw std::runtime_error(TmpStr("PartitionedEventBuf: partition %zu is full of pending events (%zu)",
+                                      key, part.pending));
+    part.buf.put(data);
+    ++part.pending;
+  }
+
+  // Even a dropped event moves the watermark along
+  for (size_t n = 0; n < parts_.size(); ++n) {
+    const size_t i = (nextStale_ + n) % parts_.size();
+    if (parts_[i].pending && stale(i, data)) {
+      ready_ = true;
+      readyPart_ = i;
+      nextStale_ = i + 1;
+      if (kept && enough(key))
+        ++parts_[key].owed;
+      return Algorithm::Status::Continue;
+    }
+  }
+
+  if (kept && enough(key)) {
+    ready_ = true;
+    readyPart_ = key;
+    return Algorithm::Status::Continue;
+  }
+
+  // A quiet cycle pays back a release lost to a stale one, if still due
+  for (size_t i = 0; i < parts_.size(); ++i) {
+    auto& part = parts_[i];
+    if (!part.owed)
+      continue;
+    if (part.pending && enough(i)) {
+      --part.owed;
+      ready_ = true;
+      readyPart_ = i;
+      break;
+    }
+    part.owed = 0;
+  }
+
+  return Algorithm::Status::Continue;
+}
+
+template <class RT, class KeyFn, class TagT>
+void PartitionedEventBuf<RT, KeyFn, TagT>::postExecute()
+{
+  if (ready_)                   // released event this cycle?
+    --parts_[readyPart_].pending;
+
+  ready_ = false;
+}
+
+// Between cycles, so nothing is ready. The partitions (and their capacities)
+// come from setPartitions, as before.
+template <class RT, class KeyFn, class TagT>
+void PartitionedEventBuf<RT, KeyFn, TagT>::saveState(StateWriter& w) const
+{
+  w.put(parts_.size());
+  for (const auto& part : parts_) {
+    w.put(part.buf);
+    w.put(part.pending);
+    w.put(part.owed);
+  }
+  w.put(nextStale_);
+}
+
+template <class RT, class KeyFn, class TagT>
+void PartitionedEventBuf<RT, KeyFn, TagT>::loadState(StateReader& r)
+{
+  size_t n;
+  r.get(n);
+  if (n != parts_.size())
+    throw std::runtime_error(TmpStr("PartitionedEventBuf: checkpoint has %zu partitions, not %zu",
+                                    n, parts_.size()));
+  for (auto& part : parts_) {
+    r.get(part.buf);
+    r.get(part.pending);
+    r.get(part.owed);
+  }
+  r.get(nextStale_);
+}
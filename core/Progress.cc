@@ -0,0 +1,71 @@
+#include "Progress.hh"
+
+#include <TFile.h>
+
+#include <cstdio>
+#include <mutex>
+
+static std::mutex outputMutex;
+
+void ProgressReporter::start()
+{
+  startTime_ = lastTime_ = Clock::now();
+  startBytes_ = lastBytes_ = TFile::GetFileBytesRead();
+  started_ = true;
+}
+
+static std::string formatDuration(double s)
+{
+  const long t = s;
+  char buf[32];
+  snprintf(buf, sizeof buf, "%ld:%02ld:%02ld", t / 3600, (t / 60) % 60, t % 60);
+  return buf;
+}
+
+// MB/s is based on TFile's global byte counter, so it covers all readers in
+// the process, not just this one
+void ProgressReporter::report(size_t nDone, size_t nTotal, size_t iFile,
+                              size_t nFiles, const char* fileName)
+{
+  const auto now = Clock::now();
+  const long long bytes = TFile::GetFileBytesRead();
+
+  const double dt = std::chrono::duration<double>(now - lastTime_).count();
+  const double elapsed = std::chrono::duration<double>(now - startTime_).count();
+
+  // Rates over the last interval; fall back to the average at the start
+  const bool fresh = dt > 0 && nDone > lastDone_;
+  const double rate = fresh ? (nDone - lastDone_) / dt
+    : elapsed > 0 ? nDone / elapsed : 0;
+  const double mbps = fresh ? (bytes - lastBytes_) / dt / 1e6
+    : elapsed > 0 ? (bytes - startBytes_) / elapsed / 1e6 : 0;
+
+  const double avgRate = elapsed > 0 ? nDone / elapsed : 0;
+  const std::string eta = (nTotal > nDone && avgRate > 0) ?
+    formatDuration((nTotal - nDone) / avgRate) : "-";
+
+  // nTotal == 0 means the reader doesn't know
+  char done[64];
+  if (nTotal)
+    snprintf(done, sizeof done, "%zu/%zu (%.1f%%)", nDone, nTotal, 100. * nDone / nTotal);
+  else
+    snprintf(done, sizeof done, "%zu", nDone);
+
+  char line[1024];
+  snprintf(line, sizeof line,
+           "[%s] %s | %.1f kHz | %.1f MB/s | ETA %s | file %zu/%zu %s\n",
+           label_.c_str(), done, rate / 1e3, mbps, eta.c_str(),
+           iFile + 1, nFiles, fileName ? fileName : "");
+
+  {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    fputs(line, stdout);
+    // Time-based reports are rare enough to flush; event-based ones may not be
+    if (everySeconds_ > 0)
+      fflush(stdout);
+  }
+
+  lastTime_ = now;
+  lastDone_ = nDone;
+  lastBytes_ = bytes;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// One-line progress reports (rate, MB/s, ETA, current file), either every N
+// events or every N seconds. Each line goes out in a single locked write, so
+// reports from several readers or threads don't get interleaved.
+class ProgressReporter {
+public:
+  ProgressReporter(const std::string& label = "") : label_(label) {}
+
+  void everyEvents(size_t n) { everyEvents_ = n; }
+  void everySeconds(double s) { everySeconds_ = s; }
+  bool enabled() const { return everyEvents_ || everySeconds_ > 0; }
+
+  bool due(size_t nDone);       // cheap enough to call on every event
+  // nTotal = 0 if unknown (then there is no percentage or ETA)
+  void report(size_t nDone, size_t nTotal, size_t iFile, size_t nFiles,
+              const char* fileName);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  // only look at the clock this often, in events
+  static constexpr size_t CLOCK_CHECK_MASK = 1023;
+
+  void start();
+
+  std::string label_;
+  size_t everyEvents_ = 0;
+  double everySeconds_ = 0;
+
+  bool started_ = false;
+  size_t calls_ = 0;
+  Clock::time_point startTime_, lastTime_;
+  size_t lastDone_ = 0;
+  long long startBytes_ = 0, lastBytes_ = 0;
+};
+
+inline
+bool ProgressReporter::due(size_t nDone)
+{
+  if (!started_)
+    start();
+
+  if (everyEvents_ && nDone % everyEvents_ == 0)
+    return true;
+
+  if (everySeconds_ > 0 && (++calls_ & CLOCK_CHECK_MASK) == 0) {
+    const std::chrono::duration<double> dt = Clock::now() - lastTime_;
+    return dt.count() >= everySeconds_;
+  }
+
+  return false;
+}
@@ -0,0 +1,154 @@
+#include "Results.hh"
+
+#include "Checkpoint.hh"
+#include "Kernel.hh"
+#include "Strings.hh"
+
+#include <TFile.h>
+#include <TH1.h>
+#include <TList.h>
+#include <TParameter.h>
+#include <TTree.h>
+
+#include <stdexcept>
+
+void ResultSet::addHist(TH1* hist, const char* outFile)
+{
+  hists.push_back({hist, outFile, hist->GetName()});
+}
+
+void ResultSet::addCounter(const char* name, Long64_t* counter, const char* outFile)
+{
+  counters.push_back({counter, outFile, name});
+}
+
+void ResultSet::addTree(TTree* tree, const char* outFile)
+{
+  trees.push_back({tree, outFile, tree->GetName()});
+}
+
+template <class T>
+static void checkMatch(const T& mine, const T& theirs)
+{
+  if (mine.size() != theirs.size())
+    throw std::runtime_error("ResultSet::merge: mismatched result sets");
+
+  for (size_t i = 0; i < mine.size(); ++i)
+    if (mine[i].name != theirs[i].name)
+      throw std::runtime_error(TmpStr("ResultSet::merge: %s vs %s",
+                                      mine[i].name.c_str(),
+                                      theirs[i].name.c_str()));
+}
+
+void ResultSet::merge(const ResultSet& other)
+{
+  checkMatch(hists, other.hists);
+  checkMatch(counters, other.counters);
+  checkMatch(trees, other.trees);
+
+  for (size_t i = 0; i < hists.size(); ++i)
+    hists[i].obj->Add(other.hists[i].obj);
+
+  for (size_t i = 0; i < counters.size(); ++i)
+    *counters[i].obj += *other.counters[i].obj;
+
+  for (size_t i = 0; i < trees.size(); ++i) {
+    TList list;
+    list.Add(other.trees[i].obj);
+    trees[i].obj->Merge(&list);
+  }
+}
+
+void ResultSet::write(Pipeline& pipeline) const
+{
+  auto file = [&](const std::string& outFile) {
+    TFile* f = pipeline.getOutFile(outFile.c_str());
+    if (!f)
+      throw std::runtime_error(TmpStr("ResultSet: no output file '%s'",
+                                      outFile.c_str()));
+    return f;
+  };
+
+  for (const auto& h : hists) {
+    file(h.outFile)->cd();
+    h.obj->Write(h.name.c_str(), TObject::kOverwrite);
+  }
+
+  for (const auto& c : counters) {
+    file(c.outFile)->cd();
+    TParameter<Long64_t>(c.name.c_str(), *c.obj).Write(c.name.c_str(), TObject::kOverwrite);
+  }
+
+  // A tree already in (a directory of) its output file (e.g. via TreeWriter)
+  // stays there; one in memory or in another file is moved to the top of it
+  for (const auto& t : trees) {
+    TFile* f = file(t.outFile);
+    TDirectory* dir = t.obj->GetDirectory();
+    if (!dir || dir->GetFile() != f) {
+      t.obj->SetDirectory(f);
+      dir = f;
+    }
+    dir->cd();
+    t.obj->Write(t.name.c_str(), TObject::kOverwrite);
+  }
+}
+
+bool ResultSet::holds(const TH1* hist) const
+{
+  for (const auto& h : hists)
+    if (h.obj == hist)
+      return true;
+  return false;
+}
+
+void ResultSet::saveState(StateWriter& w, TDirectory& dir) const
+{
+  w.put(hists.size());
+  for (size_t i = 0; i < hists.size(); ++i) {
+    w.put(hists[i].name);
+    dir.WriteTObject(hists[i].obj, TmpStr("hist%zu", i));
+  }
+
+  w.put(counters.size());
+  for (const auto& c : counters) {
+    w.put(c.name);
+    w.put(*c.obj);
+  }
+}
+
+void ResultSet::loadState(StateReader& r, TDirectory& dir)
+{
+  auto checkName = [&](const std::string& mine) {
+    std::string saved;
+    r.get(saved);
+    if (saved != mine)
+      throw std::runtime_error(TmpStr("ResultSet: checkpoint has %s instead of %s",
+                                      saved.c_str(), mine.c_str()));
+  };
+
+  size_t n;
+  r.get(n);
+  if (n != hists.size())
+    throw std::runtime_error("ResultSet: checkpoint has a different set of histograms");
+
+  for (size_t i = 0; i < hists.size(); ++i) {
+    checkName(hists[i].name);
+    TH1* saved = nullptr;
+    dir.GetObject(TmpStr("hist%zu", i), saved);
+    if (!saved)
+      throw std::runtime_error(TmpStr("ResultSet: histogram %s missing from checkpoint",
+                                      hists[i].name.c_str()));
+    hists[i].obj->Reset();
+    hists[i].obj->Add(saved);
+    delete saved;
+  }
+
+  r.get(n);
+  if (n != counters.size())
+    throw std::runtime_error("ResultSet: checkpoint has a different set of counters");
+
+  for (const auto& c : counters) {
+    checkName(c.name);
+    r.get(*c.obj);
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Rtypes.h>
+
+#include <string>
+#include <vector>
+
+class Pipeline;
+class StateReader;
+class StateWriter;
+class TDirectory;
+class TH1;
+class TTree;
+
+// Outputs that the framework knows how to combine across parallel copies of a
+// pipeline: histograms are added, counters summed, trees concatenated.
+// Algorithms register them (typically in connect()) instead of writing them
+// in finalize(); the Pipeline writes them once all finalize()s have run. An
+// empty outFile name means the default output file.
+//
+// The written form (TH1, TParameter<Long64_t>, TTree) is also what
+// TFileMerger combines correctly, so forked workers (runForked) need nothing
+// else.
+class ResultSet {
+public:
+  void addHist(TH1* hist, const char* outFile = "");
+  void addCounter(const char* name, Long64_t* counter, const char* outFile = "");
+  void addTree(TTree* tree, const char* outFile = "");
+
+  // `other` must come from an identically configured pipeline
+  void merge(const ResultSet& other);
+  void write(Pipeline& pipeline) const;
+
+  // For checkpoints: counters go into the state, histograms into `dir`. Trees
+  // are left to the checkpoint, which flushes them.
+  void saveState(StateWriter& w, TDirectory& dir) const;
+  void loadState(StateReader& r, TDirectory& dir);
+
+  bool empty() const { return hists.empty() && counters.empty() && trees.empty(); }
+  bool holds(const TH1* hist) const;
+
+private:
+  template <class T>
+  struct Entry {
+    T* obj;
+    std::string outFile;
+    std::string name;
+  };
+
+  std::vector<Entry<TH1>> hists;
+  std::vector<Entry<Long64_t>> counters;
+  std::vector<Entry<TTree>> trees;
+};
@@ -21,6 +21,7 @@ public:
   RingBuf(RingBuf&&) = default;
 
   void resize(size_t N);
+  void clear();
   void put(T item);
   // insert is O(i), use a different data structure if inserting frequently.
   // Puts item AFTER (i.e. newer than, put'd after) the one you get from at(i).
@@ -34,6 +35,12 @@ public:
   T& at(size_t i) const;
   void dump() const;            // for debugging
 
+  // Calls f(const T* ptr, size_t n) on the (at most two) contiguous pieces of
+  // storage that hold the current contents, for tight order-agnostic loops.
+  // Items within each piece run from older to newer.
+  template <class F>
+  void forEachSegment(F f) const;
+
 private:
   void advance_head();
   size_t raw_idx(int i) const;
@@ -84,6 +91,12 @@ void RingBuf<T>::resize(size_t N)
   max_size_ = N;
 }
 
+template<typename T>
+void RingBuf<T>::clear()
+{
+  head_ = size_ = 0;
+}
+
 template<typename T>
 inline
 void RingBuf<T>::advance_head()
@@ -176,6 +189,21 @@ size_t RingBuf<T>::size() const
   return size_;
 }
 
+template<typename T>
+template <class F>
+inline
+void RingBuf<T>::forEachSegment(F f) const
+{
+  if (size_ <= head_) {
+    f(&buf_[head_ - size_], size_);
+  } else {
+    const size_t nWrapped = size_ - head_;
+    f(&buf_[max_size_ - nWrapped], nWrapped);
+    if (head_ > 0)
+      f(&buf_[0], head_);
+  }
+}
+
 // -----------------------------------------------------------------------------
 
 template <typename T>
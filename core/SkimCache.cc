@@ -0,0 +1,45 @@
+#include "SkimCache.hh"
+
+#include "ConfigTool.hh"
+#include "Util.hh"
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <typeinfo>
+
+std::string skimCacheKey(Pipeline& pipeline, const Algorithm* marker)
+{
+  uint64_t h = util::hash("SkimCache v2");
+
+  // Length-prefixed, so that no two different lists of fields hash alike
+  auto add = [&](const std::string& field) {
+    h = util::hash(std::to_string(field.size()) + ":" + field, h);
+  };
+
+  for (size_t i = 0; i < pipeline.inFileCount(); ++i) {
+    const auto path = pipeline.inFilePath(i);
+    add(path);
+
+    // Remote (e.g. xrootd) paths can't be stat'd; their names alone go in
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+      add(std::to_string(st.st_size));
+      add(std::to_string(st.st_mtim.tv_sec * 1'000'000'000LL + st.st_mtim.tv_nsec));
+    } else {
+      add("-");
+    }
+  }
+
+  for (const auto alg : pipeline.algsBefore(marker)) {
+    add(typeid(*alg).name());
+    add(alg->cacheKey());
+  }
+
+  for (const auto config : pipeline.getTools<Config>())
+    add(config->serialize());
+
+  char buf[17];
+  snprintf(buf, sizeof buf, "%016llx", (unsigned long long)h);
+  return buf;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Checkpoint.hh"
+#include "EntryList.hh"
+#include "Kernel.hh"
+#include "Util.hh"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+// Key identifying the output of the pipeline prefix that precedes `marker`:
+// a hash of the input files (path, size, mtime in ns), the types and
+// cacheKey()s of the prefix algorithms, and the values of every Config tool.
+// Any other parameter of a prefix algorithm (e.g. a cut passed to its ctor)
+// must either come from a Config or go into its cacheKey(); otherwise
+// changing it silently reuses a stale skim.
+std::string skimCacheKey(Pipeline& pipeline, const Algorithm* marker);
+
+// Place this right after a prefix of stateless filters (e.g. reader +
+// CrossTriggerAlg + FlasherAlg). On the first run, it records the entries that
+// survive the prefix and saves them to cacheDir at the end of the job. Later
+// runs with the same key make the reader visit only those entries. Changing
+// the inputs or config changes the key, so stale caches are never picked up.
+template <class ReaderT>
+class SkimCache : public Algorithm {
+public:
+  SkimCache(const char* cacheDir) : cacheDir(cacheDir) {}
+
+  void connect(Pipeline& pipeline) override;
+  Algorithm::Status execute() override;
+  void finalize(Pipeline& pipeline) override;
+
+  void saveState(StateWriter& w) const override;
+  void loadState(StateReader& r) override;
+
+  bool hit() const { return hit_; }
+  const std::string& path() const { return path_; }
+
+private:
+  std::string cacheDir;
+  std::string path_;
+  ReaderT* reader = nullptr;
+  EntryBitmap survivors;
+  bool hit_ = false;
+};
+
+template <class ReaderT>
+void SkimCache<ReaderT>::connect(Pipeline& pipeline)
+{
+  reader = pipeline.getAlg<ReaderT>();
+  path_ = cacheDir + "/" + skimCacheKey(pipeline, this) + ".skim";
+
+  hit_ = util::fileExists(path_);
+  if (hit_)
+    reader->setEntryList(path_.c_str());
+}
+
+template <class ReaderT>
+Algorithm::Status SkimCache<ReaderT>::execute()
+{
+  if (!hit_ && reader->ready())
+    survivors.set(reader->currentEntry());
+
+  return Status::Continue;
+}
+
+// Only a run over the complete input (e.g. no maxEvents or entry range)
+// yields a valid cache.
+// Write to a temp file first so that concurrent jobs never see partial caches.
+template <class ReaderT>
+void SkimCache<ReaderT>::finalize(Pipeline&)
+{
+  if (hit_ || !reader->finished() || !reader->fullRange())
+    return;
+
+  const std::string tmpPath = path_ + ".tmp" + std::to_string(getpid());
+  survivors.save(tmpPath.c_str());
+  if (std::rename(tmpPath.c_str(), path_.c_str()) != 0)
+    throw std::runtime_error(TmpStr("SkimCache: couldn't rename %s to %s",
+                                    tmpPath.c_str(), path_.c_str()));
+}
+
+// A resumed job only sees the entries after the checkpoint, so the survivors
+// before it have to come from the checkpoint too.
+template <class ReaderT>
+void SkimCache<ReaderT>::saveState(StateWriter& w) const
+{
+  w.put(hit_);
+  survivors.saveState(w);
+}
+
+template <class ReaderT>
+void SkimCache<ReaderT>::loadState(StateReader& r)
+{
+  bool savedHit;
+  r.get(savedHit);
+  if (savedHit != hit_)
+    throw std::runtime_error(TmpStr("SkimCache: %s has %s since the checkpoint",
+                                    path_.c_str(), hit_ ? "appeared" : "disappeared"));
+  survivors.loadState(r);
+}
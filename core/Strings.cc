@@ -1,12 +1,72 @@
 #include "Strings.hh"
 
-#include <TString.h>
-
+#include <cstdarg>
 #include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
 
 
 static constexpr size_t BUFSIZE = 2048;
 
+// Interned strings are never freed behind the caller's back, so refuse to
+// grow past this. Hitting it means LeakStr is being fed unique strings in a
+// loop.
+static constexpr size_t INTERN_MAX_BYTES = 64 << 20;
+
+namespace {
+
+class StrArena {
+public:
+  const char* intern(const char* str);
+  void reclaim();
+  size_t bytes();
+
+private:
+  std::mutex mutex_;
+  std::unordered_set<std::string> strs_; // node-based => c_str() is stable
+  size_t bytes_ = 0;
+};
+
+const char* StrArena::intern(const char* str)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (const auto it = strs_.find(str); it != strs_.end())
+    return it->c_str();
+
+  const size_t size = strlen(str) + 1;
+  if (bytes_ + size > INTERN_MAX_BYTES)
+    throw std::runtime_error(TmpStr("LeakStr: over %zu MB of interned strings "
+                                    "(last: %.64s)", INTERN_MAX_BYTES >> 20, str));
+
+  bytes_ += size;
+  return strs_.emplace(str).first->c_str();
+}
+
+void StrArena::reclaim()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  strs_.clear();
+  bytes_ = 0;
+}
+
+size_t StrArena::bytes()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_;
+}
+
+StrArena& arena()
+{
+  static StrArena theArena;
+  return theArena;
+}
+
+} // namespace
+
 __attribute__((format(printf, 1, 2)))
 const char* LeakStr(const char* fmt, ...)
 {
@@ -16,17 +76,32 @@ const char* LeakStr(const char* fmt, ...)
   vsnprintf(buf, BUFSIZE, fmt, ap);
   va_end(ap);
 
-  return (new TString(buf))->Data();
+  return arena().intern(buf);
+}
+
+void ReclaimStrs()
+{
+  arena().reclaim();
+}
+
+size_t LeakedBytes()
+{
+  return arena().bytes();
 }
 
 __attribute__((format(printf, 1, 2)))
 const char* TmpStr(const char* fmt, ...)
 {
+  static thread_local char bufs[N_TMPSTR][BUFSIZE];
+  static thread_local size_t next = 0;
+
+  char* buf = bufs[next];
+  next = (next + 1) % N_TMPSTR;
+
   va_list ap;
   va_start(ap, fmt);
-  char buf[BUFSIZE];
   vsnprintf(buf, BUFSIZE, fmt, ap);
   va_end(ap);
 
-  return Form("%s", buf);
+  return buf;
 }
@@ -1,8 +1,23 @@
 #pragma once
 
-// "Leaky" Form; ensures result won't get clobbered
+#include <cstddef>
+
+// Interned Form; ensures result won't get clobbered. Identical strings share
+// storage, so e.g. repeated BR_VARLEN leaflists don't grow memory. Results stay
+// valid until ReclaimStrs(). The total is capped (64 MB); past that, LeakStr
+// throws std::runtime_error rather than growing without bound. Thread-safe.
 const char* LeakStr(const char* fmt, ...);
 
+// Frees everything returned by LeakStr. Only call this when you know that none
+// of those strings are still referenced (e.g. between interactive jobs).
+void ReclaimStrs();
+
+// Total size of the strings currently held for LeakStr
+size_t LeakedBytes();
+
 // Use this to explictly say "i know that this string lives in a circular buffer
-// and I'm OK with that".
+// and I'm OK with that". The buffer is thread-local, and a result stays valid
+// for the next N_TMPSTR - 1 calls on the same thread.
 const char* TmpStr(const char* fmt, ...);
+
+constexpr size_t N_TMPSTR = 16;
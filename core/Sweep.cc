@@ -0,0 +1,72 @@
+#include "Sweep.hh"
+
+#include <cstdio>
+#include <stdexcept>
+
+Sweep::Sweep(const Config& base, const std::vector<Variant>& variants,
+             const char* outPathPattern, Setup setup)
+{
+  for (size_t i = 0; i < variants.size(); ++i) {
+    auto& child = *children.emplace_back(std::make_unique<Pipeline>());
+
+    auto& config = child.makeTool<Config>(base);
+    for (const auto& [key, val] : variants[i])
+      config.set(key, val);
+
+    char path[1024];
+    snprintf(path, sizeof path, outPathPattern, i);
+    child.makeOutFile(path);
+
+    setup(child, i);
+  }
+}
+
+void Sweep::connect(Pipeline& pipeline)
+{
+  // The children's outputs would be recreated (not resumed) on restart
+  if (pipeline.checkpointing())
+    throw std::runtime_error("Sweep doesn't support checkpoints");
+
+  std::vector<std::string> inFiles;
+  for (size_t i = 0; i < pipeline.inFileCount(); ++i)
+    inFiles.push_back(pipeline.inFilePath(i));
+
+  for (const auto& child : children) {
+    child->setParent(&pipeline);
+    child->connect(inFiles);
+  }
+}
+
+Algorithm::Status Sweep::execute()
+{
+  for (const auto& child : children)
+    child->executeCycle();
+
+  return Status::Continue;
+}
+
+void Sweep::postExecute()
+{
+  for (const auto& child : children)
+    child->postExecuteCycle();
+}
+
+void Sweep::finalize(Pipeline&)
+{
+  for (const auto& child : children)
+    child->finalize();
+}
+
+void Sweep::fileChanged(const Algorithm* reader, size_t iFile)
+{
+  for (const auto& child : children)
+    child->notifyFileChanged(reader, iFile);
+}
+
+bool Sweep::carriesState() const
+{
+  for (const auto& child : children)
+    if (child->carriesState())
+      return true;
+  return false;
+}
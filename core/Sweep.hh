@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ConfigTool.hh"
+#include "Kernel.hh"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Runs N copies of a downstream algorithm chain, one per Config variant, off a
+// single set of readers, so that the I/O is paid once for all N. Each copy
+// lives in a child Pipeline holding its own Config (the base config plus the
+// variant's overrides) and its own default output file. Algs in a child find
+// the parent's readers/tools through getAlg/getTool as usual.
+//
+//   p.makeAlg<SingReader>();
+//   p.makeAlg<Sweep>(baseConfig, variants, "results_%zu.root",
+//                    [](Pipeline& child, size_t i) {
+//                      child.makeAlg<MuonAlg>();
+//                      child.makeAlg<SinglesVsMuonsAlg>();
+//                    });
+//
+// The children are stepped serially, one after another within each cycle, on
+// the loop's thread (ROOT objects aren't safe to fill from several threads).
+// The I/O is shared, but the per-variant CPU cost adds up: N variants take
+// roughly N times as long in the downstream algorithms. A SkipToNext in one
+// variant doesn't affect the others. Checkpoints aren't supported.
+class Sweep : public Algorithm {
+public:
+  using Variant = std::vector<std::pair<std::string, std::string>>; // key, value
+  using Setup = std::function<void(Pipeline& child, size_t iVariant)>;
+
+  Sweep(const Config& base, const std::vector<Variant>& variants,
+        const char* outPathPattern, Setup setup);
+
+  void connect(Pipeline& pipeline) override;
+  Algorithm::Status execute() override;
+  void postExecute() override;
+  void finalize(Pipeline& pipeline) override;
+  void fileChanged(const Algorithm* reader, size_t iFile) override;
+  bool carriesState() const override;
+
+  size_t size() const { return children.size(); }
+  Pipeline& child(size_t i) { return *children.at(i); }
+
+private:
+  std::vector<std::unique_ptr<Pipeline>> children;
+};
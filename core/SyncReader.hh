@@ -1,12 +1,19 @@
 #pragma once
 
 #include "BaseIO.hh"
+#include "ChainIndex.hh"
+#include "Checkpoint.hh"
+#include "EntryList.hh"
+#include "FlatFile.hh"
+#include "IOStats.hh"
 #include "Kernel.hh"
+#include "Progress.hh"
 #include "Util.hh"
 
 #include <TChain.h>
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -19,7 +26,8 @@ public:
   template <class... DataArgs>
   SyncReader(std::initializer_list<const char*> chainNames, DataArgs&&... data_args) :
     data(std::forward<DataArgs>(data_args)...),
-    mgr(BranchManager::IOMode::IN)
+    mgr(BranchManager::IOMode::IN),
+    progress(*chainNames.begin())
   {
     for (const auto name : chainNames)
       chains.emplace_back(std::make_unique<TChain>(name));
@@ -27,12 +35,48 @@ public:
 
   void load(const std::vector<std::string>& inFiles) override;
   Algorithm::Status execute() override;
+  void finalize(Pipeline& pipeline) override;
 
   bool ready() const { return ready_; }
   bool isReader() const override { return true; }
+  std::vector<InputRequirement> inputRequirements() override;
+
+  void saveState(StateWriter& w) const override;
+  void loadState(StateReader& r) override;
+
+  size_t currentEntry() const { return entry - 1; } // last entry read
+  bool finished() const { return finished_; }       // reached end of input
+  bool fullRange() const { return beginEntry == 0 && endEntry == EntryBitmap::npos; }
 
   SyncReader& setMaxEvents(size_t n);
-  SyncReader& setReportInterval(size_t n);
+
+  // Only read (global) entries in [first, last), e.g. one of the ranges from
+  // util::clusterRanges. Files before `first` are never announced through
+  // fileChanged; the file containing `first` is, unless it's the first file.
+  SyncReader& setEntryRange(size_t first, size_t last);
+
+  // Whether to get the next file ready while reading the current one (on
+  // by default; see Pipeline::prefetchInFile)
+  SyncReader& setFilePrefetch(bool on);
+
+  // Track bytes read, read calls, unzip time etc. (see IOMonitor), and write
+  // them to iostats/<first chain name> in `outFile` at the end of the job
+  SyncReader& enableIOStats(const char* outFile = Pipeline::DefaultFile);
+  IOStats ioStats() const;
+
+  SyncReader& setReportInterval(size_t n);     // in events
+  SyncReader& setReportPeriod(double seconds);
+
+  // Sparse reading: only visit the selected entries. Can be called any time
+  // before the loop starts. maxEvents then counts selected entries.
+  SyncReader& setEntryList(TEntryList* list);
+  SyncReader& setEntryList(const char* bitmapPath);
+  SyncReader& setEntryList(EntryBitmap bitmap);
+
+  // Read from a flat file (see convertToFlat) instead of the ROOT chains. The
+  // input file list should still be the one the flat file was made from, so
+  // that fileChanged indices refer to the same files.
+  SyncReader& setFlatInput(const char* path);
 
   TreeT data;
   const Data& getData() const { return data; }
@@ -40,53 +84,179 @@ public:
   virtual void postReadCallback() { };
 
 protected:
+  void attachEntryList();
+  bool seekNext();
+  bool readEntry(size_t i);
+  size_t treeNumber() const;
+  size_t totalEntries();
+  void report();
+
   BranchManager mgr;
   std::vector<std::unique_ptr<TChain>> chains;
-  size_t entry = 0;
+  size_t entry = 0;             // next entry to try reading
+  size_t beginEntry = 0;        // see setEntryRange
+  size_t endEntry = EntryBitmap::npos;
+  size_t nEvents = 0;           // number of entries actually read
   size_t maxEvents = 0;
-  size_t reportInterval = 0;
   bool ready_ = false;
+  bool finished_ = false;
   size_t iFile = 0;
+
+private:
+  TEntryList* rootEntryList = nullptr;
+  std::unique_ptr<TEntryList> ownedEntryList;
+  std::unique_ptr<EntryBitmap> entryList;
+  bool entryListAttached = false;
+
+  std::string flatPath;
+  std::unique_ptr<FlatFile> flat;
+
+  bool ioStatsEnabled = false;
+  std::string ioStatsFile;
+  std::unique_ptr<IOMonitor> ioMonitor; // after chains, so it's destroyed first
+
+  ProgressReporter progress;
+  bool filePrefetch = true;
+  size_t nInFiles = 0;
+  size_t chainEntries = 0;      // from the ChainIndex, if it knows every file
+  size_t nTotal = 0;
 };
 
 template <class TreeT>
 void SyncReader<TreeT>::load(const std::vector<std::string>& inFiles)
 {
+  nInFiles = inFiles.size();
+
+  if (!flatPath.empty()) {
+    flat = std::make_unique<FlatFile>(flatPath.c_str());
+    flat->adviseSequential();
+
+    mgr.mode = BranchManager::IOMode::LAYOUT;
+    data.setManager(&mgr);
+    data.initBranches();
+    flat->bind(mgr.columns);
+    return;
+  }
+
   for (size_t i = 0; i < chains.size(); ++i) {
-    util::initChain(*chains[i], inFiles);
+    util::initChain(*chains[i], inFiles, pipe().chainIndex());
     if (i > 0)
       chains[0]->AddFriend(chains[i].get());
   }
 
+  if (const ChainIndex* index = pipe().chainIndex()) {
+    size_t n = 0;
+    bool known = true;
+    for (const auto& f : inFiles) {
+      const FileIndex* idx = index->find(f, chains[0]->GetName());
+      if (!idx) {
+        known = false;
+        break;
+      }
+      n += idx->entries;
+    }
+    if (known)
+      chainEntries = n;
+  }
+
   mgr.tree = chains[0].get();
   data.setManager(&mgr);
   data.initBranches();
+
+  if (ioStatsEnabled)
+    ioMonitor = std::make_unique<IOMonitor>(chains[0]->GetName(), chains[0].get());
+
+  if (endEntry != EntryBitmap::npos)
+    chains[0]->SetCacheEntryRange(entry, endEntry);
+}
+
+// Every chain's tree, and every branch that TreeT reads from any of them
+template <class TreeT>
+std::vector<InputRequirement> SyncReader<TreeT>::inputRequirements()
+{
+  if (!flatPath.empty())
+    return {};
+
+  InputRequirement req;
+  for (const auto& chain : chains)
+    req.trees.push_back(chain->GetName());
+
+  BranchManager layout(BranchManager::IOMode::LAYOUT);
+  data.setManager(&layout);
+  data.initBranches();
+  data.setManager(&mgr);
+
+  for (const auto& column : layout.columns)
+    req.branches.push_back(column.name);
+
+  return {req};
 }
 
 template <class TreeT>
 Algorithm::Status SyncReader<TreeT>::execute()
 {
-  bool proceed = maxEvents == 0 || entry < maxEvents;
-  if (proceed && chains[0]->GetEntry(entry)) {
-    if (reportInterval && entry % reportInterval == 0)
-      std::cout << "---------- Event " << TmpStr("%7zu", entry) << " ----------" << std::endl;
+  if (!entryListAttached && (entryList || rootEntryList))
+    attachEntryList();
+
+  if (maxEvents && nEvents >= maxEvents) {
+    ready_ = false;
+    return Status::EndOfFile;
+  }
 
-    size_t current = chains[0]->GetTreeNumber();
-    if (current != iFile) {
+  if (seekNext() && entry < endEntry && readEntry(entry)) {
+    size_t current = treeNumber();
+    const bool newFile = current != iFile;
+    if (newFile) {
       iFile = current;
       pipe().notifyFileChanged(this, current);
     }
 
+    if ((newFile || nEvents == 0) && filePrefetch && !flat)
+      pipe().prefetchInFile(current + 1);
+
+    if (progress.enabled() && progress.due(nEvents))
+      report();
+
     ++entry;
+    ++nEvents;
     ready_ = true;
     postReadCallback();
     return Status::Continue;
   } else {
     ready_ = false;
+    finished_ = true;
     return Status::EndOfFile;
   }
 }
 
+template <class TreeT>
+void SyncReader<TreeT>::saveState(StateWriter& w) const
+{
+  w.put(entry);
+  w.put(nEvents);
+  w.put(iFile);
+  w.put(ready_);
+  w.put(finished_);
+}
+
+// Re-reads the last entry, since a subclass may still be holding on to it
+// (e.g. TimeSyncReader waiting for the clock). The file it's in was already
+// announced via fileChanged before the checkpoint.
+template <class TreeT>
+void SyncReader<TreeT>::loadState(StateReader& r)
+{
+  r.get(entry);
+  r.get(nEvents);
+  r.get(iFile);
+  r.get(ready_);
+  r.get(finished_);
+
+  if (nEvents > 0 && !finished_) {
+    readEntry(entry - 1);
+    postReadCallback();
+  }
+}
+
 template <class TreeT>
 SyncReader<TreeT>& SyncReader<TreeT>::setMaxEvents(size_t n)
 {
@@ -94,9 +264,203 @@ SyncReader<TreeT>& SyncReader<TreeT>::setMaxEvents(size_t n)
   return *this;
 }
 
+template <class TreeT>
+void SyncReader<TreeT>::finalize(Pipeline& pipeline)
+{
+  if (!ioMonitor)
+    return;
+
+  TFile* file = pipeline.getOutFile(ioStatsFile.c_str());
+  if (!file)
+    throw std::runtime_error(TmpStr("SyncReader: no output file '%s' for I/O stats",
+                                    ioStatsFile.c_str()));
+
+  ioMonitor->write(*file->mkdir("iostats", "", true));
+}
+
+template <class TreeT>
+SyncReader<TreeT>& SyncReader<TreeT>::enableIOStats(const char* outFile)
+{
+  ioStatsEnabled = true;
+  ioStatsFile = outFile;
+  return *this;
+}
+
+template <class TreeT>
+IOStats SyncReader<TreeT>::ioStats() const
+{
+  return ioMonitor ? ioMonitor->stats() : IOStats();
+}
+
+template <class TreeT>
+SyncReader<TreeT>& SyncReader<TreeT>::setFilePrefetch(bool on)
+{
+  filePrefetch = on;
+  return *this;
+}
+
+template <class TreeT>
+SyncReader<TreeT>& SyncReader<TreeT>::setEntryRange(size_t first, size_t last)
+{
+  if (first > last)
+    throw std::runtime_error(TmpStr("setEntryRange: first (%zu) > last (%zu)", first, last));
+
+  entry = beginEntry = first;
+  endEntry = last;
+
+  // Keep TTreeCache from prefetching baskets outside our range (i.e. those of
+  // other jobs); applied in load() if the chain isn't loaded yet
+  if (mgr.tree)
+    chains[0]->SetCacheEntryRange(first, last);
+
+  return *this;
+}
+
 template <class TreeT>
 SyncReader<TreeT>& SyncReader<TreeT>::setReportInterval(size_t n)
 {
-  reportInterval = n;
+  progress.everyEvents(n);
+  return *this;
+}
+
+template <class TreeT>
+SyncReader<TreeT>& SyncReader<TreeT>::setReportPeriod(double seconds)
+{
+  progress.everySeconds(seconds);
+  return *this;
+}
+
+// 0 if unknown. Never asks the chain, since TChain::GetEntries opens every
+// file's header, which mid-loop means a long stall (and a file switch). Without
+// an entry range, a list or a ChainIndex, progress is reported without an ETA.
+template <class TreeT>
+size_t SyncReader<TreeT>::totalEntries()
+{
+  if (nTotal == 0) {
+    const size_t first = beginEntry;
+
+    if (entryList)
+      nTotal = entryList->count(first, endEntry);
+    else if (flat)
+      nTotal = std::min<size_t>(flat->size(), endEntry) - std::min<size_t>(flat->size(), first);
+    else if (endEntry != EntryBitmap::npos)
+      nTotal = endEntry - first;
+    else if (chainEntries)
+      nTotal = chainEntries - std::min(chainEntries, first);
+    else
+      return 0;
+
+    if (maxEvents)
+      nTotal = std::min(nTotal, maxEvents);
+  }
+
+  return nTotal;
+}
+
+template <class TreeT>
+void SyncReader<TreeT>::report()
+{
+  std::string fileName = flatPath;
+  if (!flat && chains[0]->GetCurrentFile())
+    fileName = chains[0]->GetCurrentFile()->GetName();
+
+  progress.report(nEvents, totalEntries(), iFile, nInFiles, fileName.c_str());
+}
+
+template <class TreeT>
+inline
+bool SyncReader<TreeT>::readEntry(size_t i)
+{
+  if (flat)
+    return flat->load(i);
+
+  if (!ioMonitor)
+    return chains[0]->GetEntry(i) > 0;
+
+  const Int_t prevTree = chains[0]->GetTreeNumber();
+  const auto start = std::chrono::steady_clock::now();
+  const bool ok = chains[0]->GetEntry(i) > 0;
+  const std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+
+  ioMonitor->afterRead(took.count(), chains[0]->GetTreeNumber() != prevTree);
+  return ok;
+}
+
+template <class TreeT>
+inline
+size_t SyncReader<TreeT>::treeNumber() const
+{
+  if (flat)
+    return flat->fileOf(entry);
+
+  return chains[0]->GetTreeNumber();
+}
+
+template <class TreeT>
+SyncReader<TreeT>& SyncReader<TreeT>::setFlatInput(const char* path)
+{
+  flatPath = path;
+  return *this;
+}
+
+template <class TreeT>
+SyncReader<TreeT>& SyncReader<TreeT>::setEntryList(TEntryList* list)
+{
+  rootEntryList = list;
+  entryList.reset();
+  entryListAttached = false;
   return *this;
 }
+
+template <class TreeT>
+SyncReader<TreeT>& SyncReader<TreeT>::setEntryList(const char* bitmapPath)
+{
+  return setEntryList(EntryBitmap::load(bitmapPath));
+}
+
+template <class TreeT>
+SyncReader<TreeT>& SyncReader<TreeT>::setEntryList(EntryBitmap bitmap)
+{
+  rootEntryList = nullptr;
+  entryList = std::make_unique<EntryBitmap>(std::move(bitmap));
+  entryListAttached = false;
+  return *this;
+}
+
+// Deferred until the first execute() since TEntryList conversion needs the
+// chain to be loaded. We iterate over our own bitmap, but we also hand a
+// TEntryList to the chain, since that lets TTreeCache skip clusters (and hence
+// baskets) that contain no selected entries.
+template <class TreeT>
+void SyncReader<TreeT>::attachEntryList()
+{
+  entryListAttached = true;
+
+  if (flat) {
+    if (rootEntryList)
+      throw std::runtime_error("TEntryList can't be used with a flat input");
+    return;
+  }
+
+  TChain& chain = *chains[0];
+
+  if (rootEntryList) {
+    entryList = std::make_unique<EntryBitmap>(
+      EntryBitmap::fromEntryList(*rootEntryList, chain));
+    chain.SetEntryList(rootEntryList);
+  } else {
+    ownedEntryList.reset(entryList->toEntryList(chain));
+    chain.SetEntryList(ownedEntryList.get());
+  }
+}
+
+template <class TreeT>
+inline
+bool SyncReader<TreeT>::seekNext()
+{
+  if (!entryList)
+    return true;
+
+  entry = entryList->next(entry);
+  return entry != EntryBitmap::npos;
+}
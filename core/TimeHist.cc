@@ -0,0 +1,124 @@
+#include "TimeHist.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Process this many times per pass, so the temporaries stay in L1
+static constexpr size_t CHUNK = 256;
+
+// 2^52 + 2^51: adding an integer below 2^51 in magnitude only changes the
+// low mantissa bits of this double
+static constexpr double MAGIC_DOUBLE = 6755399441055744.0;
+static constexpr int64_t MAGIC_BITS = 0x4338000000000000;
+static constexpr int64_t MAGIC_RANGE = int64_t(1) << 51;
+
+// Leave it to Fill() whenever that does more than find the bin and count:
+// variable bins, a fill buffer, an axis that grows to fit, under/overflows
+// that count in the stats, or a user range (GetStats then recomputes the
+// stats from the bins in range, so ours would be thrown away).
+static bool canUseKernel(const TH1& h)
+{
+  const TAxis* axis = h.GetXaxis();
+  return h.GetDimension() == 1 && !h.GetBuffer() && axis->GetXbins()->fN == 0
+    && !axis->CanExtend() && !axis->TestBit(TAxis::kAxisRange)
+    && !h.GetStatOverflowsBehaviour();
+}
+
+void fillTimeDiffs(TH1& h, Time t, const Time* times, size_t n)
+{
+  if (n == 0)
+    return;
+
+  if (!canUseKernel(h)) {
+    for (size_t i = 0; i < n; ++i)
+      h.Fill(t.diff_us(times[i]));
+    return;
+  }
+
+  const TAxis* axis = h.GetXaxis();
+  const int nbins = axis->GetNbins();
+  const double xmin = axis->GetXmin();
+  const double xmax = axis->GetXmax();
+  const double width = xmax - xmin;
+
+  // bins 0 and nbins+1 are under/overflow, as in TH1
+  static thread_local std::vector<UInt_t> counts;
+  counts.assign(nbins + 2, 0);
+
+  // Accumulate straight into the existing stats, so that the sums round
+  // exactly as a run of Fill() calls after the earlier entries would. Grab
+  // them before touching the bins, since GetStats can fall back on the bin
+  // contents.
+  double stats[TH1::kNstat] = {};
+  h.GetStats(stats);
+
+  const int64_t tNanos = t.nanos;
+
+  for (size_t begin = 0; begin < n; begin += CHUNK) {
+    const size_t len = std::min(CHUNK, n - begin);
+    const Time* __restrict chunk = times + begin;
+
+    double x[CHUNK];
+    int bin[CHUNK];
+
+    // Same arithmetic as Time::diff_us. The int64 -> double conversion has no
+    // SSE2 instruction, so use the exponent trick, which is exact as long as
+    // |diff| < 2^51 ns (~26 days); fall back to plain conversion otherwise.
+    uint64_t outOfRange = 0;
+    for (size_t i = 0; i < len; ++i) {
+      const int64_t d = tNanos - chunk[i].nanos;
+      outOfRange |= uint64_t(d + MAGIC_RANGE) >> 52;
+      double dd;
+      const int64_t bits = d + MAGIC_BITS;
+      memcpy(&dd, &bits, sizeof dd);
+      x[i] = 1e-3 * (dd - MAGIC_DOUBLE);
+    }
+    if (outOfRange) {
+      for (size_t i = 0; i < len; ++i)
+        x[i] = t.diff_us(chunk[i]);
+    }
+
+    // Same expression as TAxis::FindFixBin, so that values on (or within
+    // rounding of) a bin edge land in the same bin. Clamp before converting
+    // to int so that far-away times can't overflow.
+    for (size_t i = 0; i < len; ++i) {
+      const double pos = std::min(std::max(nbins * (x[i] - xmin) / width, -1.), double(nbins));
+      const int b = 1 + int(pos);
+      const bool under = x[i] < xmin, over = x[i] >= xmax;
+      bin[i] = under ? 0 : over ? nbins + 1 : b;
+    }
+
+    // Fill() only counts in-range entries in the stats. (Kept scalar so that
+    // the sums are accumulated in the same order as Fill() would.)
+    for (size_t i = 0; i < len; ++i) {
+      ++counts[bin[i]];
+      if (bin[i] > 0 && bin[i] <= nbins) {
+        stats[0] += 1;          // sumw
+        stats[1] += 1;          // sumw2
+        stats[2] += x[i];       // sumwx
+        stats[3] += x[i] * x[i]; // sumwx2
+      }
+    }
+  }
+
+  const bool sumw2 = h.GetSumw2N() > 0;
+  for (int b = 0; b <= nbins + 1; ++b) {
+    if (counts[b] == 0)
+      continue;
+    h.AddBinContent(b, counts[b]);
+    if (sumw2)
+      h.GetSumw2()->fArray[b] += counts[b];
+  }
+
+  const double entries = h.GetEntries() + n;
+  h.PutStats(stats);
+  h.SetEntries(entries);
+}
+
+void fillTimeDiffs(TH1& h, Time t, const RingBuf<Time>& times)
+{
+  times.forEachSegment([&](const Time* ptr, size_t n) {
+    fillTimeDiffs(h, t, ptr, n);
+  });
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "RingBuf.hh"
+#include "Util.hh"
+
+#include <TH1.h>
+
+// Equivalent to calling h.Fill(t.diff_us(times[i])) for each i, but much
+// faster for long lists (e.g. one delayed candidate vs. 1000 muons): the time
+// differences and bin indices are computed in a vectorizable loop, counted in
+// a local integer histogram, and added to h in one go at the end, along with
+// the statistics that Fill() would have accumulated.
+//
+// Histograms with variable bins, a fill buffer, an extendable axis, a user
+// axis range or StatOverflows fall back to plain Fill().
+void fillTimeDiffs(TH1& h, Time t, const Time* times, size_t n);
+void fillTimeDiffs(TH1& h, Time t, const RingBuf<Time>& times);
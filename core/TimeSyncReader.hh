@@ -24,6 +24,9 @@ public:
   void connect(Pipeline& pipeline) override;
   Algorithm::Status execute() override;
 
+  void saveState(StateWriter& w) const override;
+  void loadState(StateReader& r) override;
+
   virtual Time timeInTree() = 0;
 
   bool is_prefetching() { return prefetching; };
@@ -52,10 +55,28 @@ void TimeSyncReader<TreeT>::connect(Pipeline& pipeline)
   SyncReader<TreeT>::connect(pipeline);
 }
 
+template <class TreeT>
+void TimeSyncReader<TreeT>::saveState(StateWriter& w) const
+{
+  SyncReader<TreeT>::saveState(w);
+  w.put(prefetching);
+  w.put(prefetchStart);
+  w.put(prevTime);
+}
+
+template <class TreeT>
+void TimeSyncReader<TreeT>::loadState(StateReader& r)
+{
+  SyncReader<TreeT>::loadState(r);
+  r.get(prefetching);
+  r.get(prefetchStart);
+  r.get(prevTime);
+}
+
 template <class TreeT>
 Algorithm::Status TimeSyncReader<TreeT>::execute()
 {
-  const bool first = this->entry == 0;
+  const bool first = this->nEvents == 0;
 
   // ready_ implies that event was published on last execution, in which case
   // we're ready to fetch a new one
@@ -75,9 +96,9 @@ Algorithm::Status TimeSyncReader<TreeT>::execute()
   }
 
   else {                        // ClockReader
-    const float dtClock_us = timeInTree().diff_us(clock->current());
-    const float dtPrev_us = timeInTree().diff_us(prevTime);
-    const float dtPrefetch_us = timeInTree().diff_us(prefetchStart);
+    const double dtClock_us = timeInTree().diff_us(clock->current());
+    const double dtPrev_us = timeInTree().diff_us(prevTime);
+    const double dtPrefetch_us = timeInTree().diff_us(prefetchStart);
 
     const bool foundGap = dtPrev_us > gapThreshold_us;
     const bool tooFarAhead = dtClock_us > leadtime_us;
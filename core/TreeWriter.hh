@@ -64,6 +64,19 @@ template <class TreeT>
 void TreeWriter<TreeT>::connect(Pipeline& p, const char* outFileName)
 {
   TFile* f = p.getOutFile(outFileName);
+
+  // When resuming from a checkpoint, keep filling the tree that's already
+  // there (BranchManager then reuses its branches)
+  if (p.resuming()) {
+    mgr.tree->SetDirectory(nullptr);
+    TTree* existing = nullptr;
+    f->GetObject(mgr.tree->GetName(), existing);
+    if (existing) {
+      delete mgr.tree;
+      mgr.tree = existing;
+    }
+  }
+
   mgr.tree->SetDirectory(f);           // TODO Support subdirectories
 
   data.setManager(&mgr);
@@ -75,6 +88,7 @@ TreeWriter<TreeT>::~TreeWriter()
 {
   if (mgr.tree) {
     mgr.tree->GetDirectory()->cd();
-    mgr.tree->Write();
+    // overwrite, in case it was already written as a registered result
+    mgr.tree->Write("", TObject::kOverwrite);
   }
 }
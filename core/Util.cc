@@ -1,19 +1,72 @@
 #include "Util.hh"
 
+#include "ChainIndex.hh"
+
+#include <cxxabi.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
 namespace util {
 
-void initChain(TChain& chain, const std::vector<std::string>& inFiles)
+void initChain(TChain& chain, const std::vector<std::string>& inFiles, ChainIndex* index)
 {
-  for (const auto& f : inFiles)
-    chain.Add(f.c_str());
+  for (const auto& f : inFiles) {
+    const FileIndex* idx = index ? index->get(f, chain.GetName()) : nullptr;
+    if (idx && idx->entries > 0)
+      chain.Add(f.c_str(), idx->entries);
+    else
+      chain.Add(f.c_str());
+  }
 
   chain.SetMakeClass(true);
   chain.SetBranchStatus("*", false);
 }
 
+std::vector<std::pair<size_t, size_t>> clusterRanges(TChain& chain, size_t n)
+{
+  const size_t total = chain.GetEntries(); // also fills the tree offsets
+
+  // Global entry numbers at which clusters start, plus the end
+  std::vector<size_t> bounds;
+  for (int i = 0; i < chain.GetNtrees(); ++i) {
+    const Long64_t offset = chain.GetTreeOffset()[i];
+    chain.LoadTree(offset);
+    TTree* tree = chain.GetTree();
+
+    const Long64_t nEntries = tree->GetEntries();
+    auto clusters = tree->GetClusterIterator(0);
+    Long64_t start;
+    while ((start = clusters.Next()) < nEntries)
+      bounds.push_back(offset + start);
+  }
+  bounds.push_back(total);
+
+  return splitAtBounds(bounds, n);
+}
+
+std::vector<std::pair<size_t, size_t>> splitAtBounds(const std::vector<size_t>& bounds,
+                                                     size_t n)
+{
+  const size_t total = bounds.back();
+
+  std::vector<std::pair<size_t, size_t>> ranges;
+  size_t first = 0;
+  for (size_t k = 1; k <= n && first < total; ++k) {
+    const size_t target = k == n ? total : total * k / n;
+    const size_t last = *std::lower_bound(bounds.begin(), bounds.end(), target);
+    if (last > first) {
+      ranges.emplace_back(first, last);
+      first = last;
+    }
+  }
+
+  return ranges;
+}
+
 template <typename T>
 T clone(const T& parent, const char* name, const char* title)
 {
@@ -36,5 +89,43 @@ std::vector<std::string> parse_infile_arg(const char* arg)
   return result;
 }
 
+bool fileExists(const std::string& path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+std::string workerPath(const std::string& path, const std::string& workerId)
+{
+  const auto slash = path.find_last_of('/');
+  auto dot = path.find_last_of('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    dot = path.size();
+
+  return path.substr(0, dot) + ".w" + workerId + path.substr(dot);
+}
+
+std::string demangle(const char* name)
+{
+  int status = 0;
+  char* readable = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+  if (status != 0)
+    return name;
+
+  std::string result = readable;
+  free(readable);
+  return result;
+}
+
+uint64_t hash(const std::string& str, uint64_t seed)
+{
+  uint64_t h = seed;
+  for (const unsigned char c : str) {
+    h ^= c;
+    h *= 0x100000001b3;
+  }
+  return h;
+}
+
 } // namespace util
 
@@ -2,12 +2,32 @@
 
 #include <TChain.h>
 
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <utility>
 #include <vector>
 #include <string>
 
+class ChainIndex;
+
 namespace util {
 
-void initChain(TChain& chain, const std::vector<std::string>& inFiles);
+// With an index, files are added with their known entry counts, so that the
+// chain doesn't have to open each of them to find out
+void initChain(TChain& chain, const std::vector<std::string>& inFiles,
+               ChainIndex* index = nullptr);
+
+// Split the chain's entries into (at most) n contiguous [first, last) ranges
+// of similar size, each starting and ending on a TTree cluster boundary, so
+// that jobs reading different ranges never need the same baskets. Fewer than
+// n ranges come back if there aren't enough clusters.
+std::vector<std::pair<size_t, size_t>> clusterRanges(TChain& chain, size_t n);
+
+// Same, given the sorted cluster starts followed by the total entry count
+std::vector<std::pair<size_t, size_t>> splitAtBounds(const std::vector<size_t>& bounds,
+                                                     size_t n);
 
 template <typename T>
 T clone(const T& parent, const char* name, const char* title = nullptr);
@@ -15,6 +35,17 @@ T clone(const T& parent, const char* name, const char* title = nullptr);
 // If arg is '-', read list from stdin; otherwise return {arg}.
 std::vector<std::string> parse_infile_arg(const char* arg);
 
+bool fileExists(const std::string& path);
+
+// "dir/foo.root" -> "dir/foo.w3.root"
+std::string workerPath(const std::string& path, const std::string& workerId);
+
+// Readable form of a typeid(...).name()
+std::string demangle(const char* name);
+
+// FNV-1a; pass the previous result as `seed` to hash several strings
+uint64_t hash(const std::string& str, uint64_t seed = 0xcbf29ce484222325);
+
 } // namespace util
 
 // -----------------------------------------------------------------------------
@@ -36,57 +67,43 @@ bool operator>= (T const& lhs, T const& rhs) { return !(lhs < rhs); }
 
 } // namespace relational
 
+// A timestamp as a single count of nanoseconds (since the epoch, for DAQ
+// times). Differences are exact integers, and comparisons are plain 64-bit
+// ones, so arrays of Times are easy for the compiler to vectorize over.
 struct Time : relational::tag {
-  UInt_t s, ns;
-
-  Time() : s(0), ns(0) { }
-  Time(UInt_t s_, UInt_t ns_) : s(s_), ns(ns_) { }
-
-  float diff_us(const Time& other) const;
+  int64_t nanos;
 
-  Time shifted_us(float diff_us) const;
+  Time() : nanos(0) { }
+  Time(UInt_t s, UInt_t ns) : nanos(int64_t(s) * NS_PER_S + ns) { }
 
-  bool operator<(const Time& other) const;
+  static Time fromNanos(int64_t nanos) { Time t; t.nanos = nanos; return t; }
 
-  bool operator==(const Time& other) const;
-};
+  UInt_t sec() const { return nanos / NS_PER_S; }
+  UInt_t nsec() const { return nanos % NS_PER_S; }
 
-inline
-float Time::diff_us(const Time& other) const
-{
-  // cast to enable signed arithmetic
-  int s1 = s, ns1 = ns, s2 = other.s, ns2 = other.ns;
-  return 1e6*(s1 - s2) + 1e-3*(ns1 - ns2);
-}
+  int64_t diff_ns(const Time& other) const { return nanos - other.nanos; }
+  double diff_us(const Time& other) const { return 1e-3 * diff_ns(other); }
 
-inline
-Time Time::shifted_us(float diff_us) const
-{
-  const int delta_s = 1e-6 * diff_us;
-  const int delta_ns = 1e3 * (diff_us - 1e6*delta_s);
-
-  UInt_t new_s = s + delta_s;
-  int new_ns = ns + delta_ns;
+  Time shifted_ns(int64_t diff_ns) const { return fromNanos(nanos + diff_ns); }
+  Time shifted_us(double diff_us) const;
 
-  if (new_ns > int(1e9)) {
-    new_ns -= int(1e9);
-    new_s += 1;
-  } else if (new_ns < 0) {
-    new_ns += int(1e9);
-    new_s -= 1;
-  }
+  bool operator<(const Time& other) const { return nanos < other.nanos; }
+  bool operator==(const Time& other) const { return nanos == other.nanos; }
 
-  return { new_s, UInt_t(new_ns) };
-}
+  static constexpr int64_t NS_PER_S = 1'000'000'000;
+};
 
 inline
-bool Time::operator<(const Time& other) const
+Time Time::shifted_us(double diff_us) const
 {
-  return s < other.s || (s == other.s && ns < other.ns);
+  return shifted_ns(std::llround(1e3 * diff_us));
 }
 
+// "<sec>.<nsec>", e.g. for RingBuf::dump
 inline
-bool Time::operator==(const Time& other) const
+std::ostream& operator<<(std::ostream& os, const Time& t)
 {
-  return s == other.s && ns == other.ns;
+  char buf[32];
+  snprintf(buf, sizeof buf, "%u.%09u", t.sec(), t.nsec());
+  return os << buf;
 }
@@ -0,0 +1,99 @@
+#include "VetoIndex.hh"
+
+#include "Checkpoint.hh"
+#include "Strings.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+VetoIndex::VetoIndex(size_t nDetectors) :
+  dets_(nDetectors)
+{
+}
+
+VetoIndex::Det& VetoIndex::det(size_t det)
+{
+  if (det >= dets_.size())
+    throw std::runtime_error(TmpStr("VetoIndex: detector %zu out of range (%zu detectors)",
+                                    det, dets_.size()));
+  return dets_[det];
+}
+
+void VetoIndex::setVeto(size_t iDet, std::vector<std::pair<float, double>> steps)
+{
+  std::sort(steps.begin(), steps.end());
+  det(iDet).steps = std::move(steps);
+}
+
+void VetoIndex::addMuon(size_t iDet, Time t, float energy)
+{
+  Det& d = det(iDet);
+
+  if (!d.muons.empty() && t < d.muons.back())
+    throw std::runtime_error("VetoIndex: muons must be added in time order");
+  if (t.nanos < d.cursor)
+    throw std::runtime_error("VetoIndex: muon added behind the query cursor");
+
+  // The last step whose threshold we pass
+  double veto_us = -1;
+  for (const auto& [minEnergy, stepVeto_us] : d.steps) {
+    if (energy < minEnergy)
+      break;
+    veto_us = stepVeto_us;
+  }
+
+  d.muons.push_back(t);
+
+  if (veto_us < 0)
+    return;
+
+  const int64_t end = t.nanos + std::llround(1e3 * veto_us);
+
+  if (!d.intervals.empty() && t.nanos <= d.intervals.back().end)
+    d.intervals.back().end = std::max(d.intervals.back().end, end);
+  else
+    d.intervals.push_back({t.nanos, end});
+}
+
+double VetoIndex::vetoedTime_s(size_t iDet) const
+{
+  if (iDet >= dets_.size())
+    throw std::runtime_error(TmpStr("VetoIndex: detector %zu out of range (%zu detectors)",
+                                    iDet, dets_.size()));
+  const Det& d = dets_[iDet];
+
+  // Intervals don't overlap, so only the front one can straddle the cursor
+  int64_t nanos = d.vetoedNanos;
+  if (!d.intervals.empty() && d.intervals.front().start < d.cursor)
+    nanos += std::min(d.intervals.front().end, d.cursor) - d.intervals.front().start;
+
+  return 1e-9 * nanos;
+}
+
+// The steps come from setVeto, as before
+void VetoIndex::saveState(StateWriter& w) const
+{
+  w.put(dets_.size());
+  for (const Det& d : dets_) {
+    w.put(d.intervals);
+    w.put(d.muons);
+    w.put(d.cursor);
+    w.put(d.vetoedNanos);
+  }
+}
+
+void VetoIndex::loadState(StateReader& r)
+{
+  size_t n;
+  r.get(n);
+  if (n != dets_.size())
+    throw std::runtime_error(TmpStr("VetoIndex: checkpoint has %zu detectors, not %zu",
+                                    n, dets_.size()));
+  for (Det& d : dets_) {
+    r.get(d.intervals);
+    r.get(d.muons);
+    r.get(d.cursor);
+    r.get(d.vetoedNanos);
+  }
+}
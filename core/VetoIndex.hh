@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Kernel.hh"
+#include "Util.hh"
+
+#include <deque>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Muon veto windows as per-detector sets of merged [t_mu, t_mu + veto]
+// intervals. Muons are added in time order (e.g. by a MuonAlg) and events are
+// queried in time order, so each query just advances a cursor past the
+// intervals that have ended: amortized O(1), and memory only holds the
+// intervals that are still ahead of the cursor. Muons may run ahead of the
+// queries (as with a prefetching TimeSyncReader), but not behind them.
+//
+// The veto length depends on the detector and the muon's energy (charge,
+// nHit, ...): see setVeto(). The total vetoed time only counts up to the
+// latest query, so vetoes that extend past it (or muons that ran ahead) don't
+// inflate the dead time of the period that has actually been looked at.
+class VetoIndex : public Tool {
+public:
+  VetoIndex(size_t nDetectors = 1);
+
+  bool carriesState() const override { return true; }
+  void saveState(StateWriter& w) const override;
+  void loadState(StateReader& r) override;
+
+  // Steps of {minEnergy, veto_us}: a muon gets the veto of the highest
+  // minEnergy <= its energy; below the lowest step there's no veto.
+  void setVeto(size_t det, std::vector<std::pair<float, double>> steps);
+
+  void addMuon(size_t det, Time t, float energy = 0);
+
+  bool isVetoed(size_t det, Time t);
+  // Negative if there's no muon at or before t
+  double timeSinceLastMuon_us(size_t det, Time t);
+
+  // Up to the latest query time
+  double vetoedTime_s(size_t det) const;
+  size_t detectors() const { return dets_.size(); }
+
+private:
+  struct Interval {
+    int64_t start, end;
+  };
+
+  struct Det {
+    std::vector<std::pair<float, double>> steps;
+
+    std::deque<Interval> intervals;     // merged, still ahead of the cursor
+    std::deque<Time> muons;             // last one at/before cursor, then later
+    int64_t cursor = INT64_MIN;
+    int64_t vetoedNanos = 0;            // of the intervals behind the cursor
+  };
+
+  Det& det(size_t det);
+  void advance(Det& d, Time t);
+
+  std::vector<Det> dets_;
+};
+
+inline
+void VetoIndex::advance(Det& d, Time t)
+{
+  if (t.nanos < d.cursor)
+    throw std::runtime_error("VetoIndex: queries must be in time order");
+  d.cursor = t.nanos;
+
+  while (!d.intervals.empty() && d.intervals.front().end < t.nanos) {
+    d.vetoedNanos += d.intervals.front().end - d.intervals.front().start;
+    d.intervals.pop_front();
+  }
+
+  while (d.muons.size() > 1 && d.muons[1] <= t)
+    d.muons.pop_front();
+}
+
+inline
+bool VetoIndex::isVetoed(size_t iDet, Time t)
+{
+  Det& d = det(iDet);
+  advance(d, t);
+  return !d.intervals.empty() && d.intervals.front().start <= t.nanos;
+}
+
+inline
+double VetoIndex::timeSinceLastMuon_us(size_t iDet, Time t)
+{
+  Det& d = det(iDet);
+  advance(d, t);
+  if (d.muons.empty() || t < d.muons.front())
+    return -1;
+  return t.diff_us(d.muons.front());
+}
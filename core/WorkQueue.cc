@@ -0,0 +1,488 @@
+#include "WorkQueue.hh"
+
+#include "Fanout.hh"
+#include "Strings.hh"
+#include "Util.hh"
+
+#include <TChain.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+static const char* const STATES[] = {"todo", "claimed", "done", "failed"};
+static constexpr const char* RANGE_TAG = "#range";
+static constexpr double MAX_HEARTBEAT_SECONDS = 60;
+
+// In chunk order: "c100000" comes after "c99999"
+static std::vector<std::string> listDir(const std::string& path)
+{
+  std::vector<std::string> names;
+
+  DIR* dir = opendir(path.c_str());
+  if (!dir)
+    throw std::runtime_error(TmpStr("WorkQueue: can't read %s", path.c_str()));
+
+  while (const dirent* ent = readdir(dir))
+    if (ent->d_name[0] != '.')  // also skips our temp files
+      names.push_back(ent->d_name);
+
+  closedir(dir);
+  auto key = [](const std::string& name) {
+    return std::make_pair(strtoul(name.c_str() + 1, nullptr, 10), std::cref(name));
+  };
+  std::sort(names.begin(), names.end(),
+            [&](const std::string& a, const std::string& b) { return key(a) < key(b); });
+  return names;
+}
+
+static std::string hostPid()
+{
+  char host[256] = "";
+  gethostname(host, sizeof host - 1);
+  return std::string(host) + "." + std::to_string(getpid());
+}
+
+// "c00042.t1@host.pid" -> number 42, tries 1
+static void parseName(const std::string& fileName, WorkChunk& chunk)
+{
+  const auto dot = fileName.find(".t");
+  chunk.name = fileName.substr(0, dot);
+  chunk.number = std::stoul(chunk.name.substr(1));
+  chunk.tries = dot == std::string::npos ? 0 : std::stoul(fileName.substr(dot + 2));
+}
+
+// The current time according to the filesystem holding `dir`, which is what
+// sets the claims' mtimes. The local clock may disagree with a file server's.
+static time_t fsNow(const std::string& dir)
+{
+  const std::string probe = dir + "/." + hostPid() + ".now";
+  std::ofstream(probe, std::ios::trunc);
+  utime(probe.c_str(), nullptr);
+
+  struct stat st;
+  const bool ok = stat(probe.c_str(), &st) == 0;
+  std::remove(probe.c_str());
+  if (!ok)
+    throw std::runtime_error(TmpStr("WorkQueue: can't write in %s", dir.c_str()));
+  return st.st_mtime;
+}
+
+// Worker ID of one attempt at a chunk, unique across retries and workers
+static std::string attemptId(const WorkChunk& chunk)
+{
+  return std::to_string(chunk.number) + ".t" + std::to_string(chunk.tries) + "-" + hostPid();
+}
+
+static size_t fileSize(const std::string& path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+// -----------------------------------------------------------------------------
+
+WorkQueue::WorkQueue(const std::string& dir) :
+  dir_(dir)
+{
+  mkdir(dir_.c_str(), 0775);
+  for (const char* state : STATES) {
+    const std::string sub = dir_ + "/" + state;
+    if (mkdir(sub.c_str(), 0775) != 0 && errno != EEXIST)
+      throw std::runtime_error(TmpStr("WorkQueue: can't create %s", sub.c_str()));
+
+    for (const auto& name : listDir(sub)) {
+      WorkChunk chunk;
+      parseName(name, chunk);
+      nextNumber_ = std::max(nextNumber_, chunk.number + 1);
+    }
+  }
+}
+
+std::string WorkQueue::path(const char* state, const std::string& name) const
+{
+  return dir_ + "/" + state + "/" + name;
+}
+
+std::string WorkQueue::claimName(const WorkChunk& chunk) const
+{
+  return chunk.name + ".t" + std::to_string(chunk.tries) + "@" + hostPid();
+}
+
+void WorkQueue::writeAtomically(const std::string& dest, const std::string& contents) const
+{
+  const auto slash = dest.find_last_of('/');
+  const std::string tmp = dest.substr(0, slash + 1) + "." + dest.substr(slash + 1)
+    + ".tmp" + std::to_string(getpid());
+
+  {
+    std::ofstream ofs(tmp, std::ios::trunc);
+    ofs << contents;
+    if (!ofs)
+      throw std::runtime_error(TmpStr("WorkQueue: can't write %s", tmp.c_str()));
+  }
+
+  if (std::rename(tmp.c_str(), dest.c_str()) != 0)
+    throw std::runtime_error(TmpStr("WorkQueue: can't rename %s", tmp.c_str()));
+}
+
+WorkQueue WorkQueue::create(const std::string& dir, const std::vector<std::string>& files,
+                            size_t targetBytes, const char* treeName, ChainIndex* index)
+{
+  WorkQueue queue(dir);
+  for (const char* state : STATES)
+    if (queue.count(state))
+      throw std::runtime_error(TmpStr("WorkQueue: %s is not empty", dir.c_str()));
+
+  std::vector<std::string> group;
+  size_t groupBytes = 0;
+
+  auto flush = [&] {
+    if (!group.empty())
+      queue.addChunk(group);
+    group.clear();
+    groupBytes = 0;
+  };
+
+  for (const auto& file : files) {
+    // Unknown (e.g. remote) files count as a whole chunk
+    size_t size = fileSize(file);
+    if (size == 0)
+      size = targetBytes;
+
+    if (treeName && size > 2 * targetBytes) {
+      flush();
+      const size_t nRanges = (size + targetBytes - 1) / targetBytes;
+      std::vector<std::pair<size_t, size_t>> ranges;
+      if (index) {
+        ranges = index->clusterRanges({file}, treeName, nRanges);
+      } else {
+        TChain chain(treeName);
+        chain.Add(file.c_str());
+        ranges = util::clusterRanges(chain, nRanges);
+      }
+      for (const auto& [first, last] : ranges)
+        queue.addChunk({file}, first, last);
+      continue;
+    }
+
+    group.push_back(file);
+    groupBytes += size;
+    if (groupBytes >= targetBytes)
+      flush();
+  }
+
+  flush();
+  return queue;
+}
+
+void WorkQueue::addChunk(const std::vector<std::string>& files, size_t first, size_t last)
+{
+  std::string contents;
+  if (first != 0 || last != EntryBitmap::npos)
+    contents += TmpStr("%s %zu %zu\n", RANGE_TAG, first, last);
+  for (const auto& file : files)
+    contents += file + "\n";
+
+  const std::string name = TmpStr("c%05zu.t0", nextNumber_++);
+  writeAtomically(path("todo", name), contents);
+}
+
+bool WorkQueue::claim(WorkChunk& chunk)
+{
+  for (int pass = 0; pass < 2; ++pass) {
+    auto names = listDir(dir_ + "/todo");
+
+    // Start at a different place in each process, to spread out contention
+    if (!names.empty())
+      std::rotate(names.begin(), names.begin() + getpid() % names.size(), names.end());
+
+    for (const auto& name : names) {
+      WorkChunk c;
+      parseName(name, c);
+      const std::string todo = path("todo", name);
+      const std::string claimed = path("claimed", claimName(c));
+
+      // rename keeps the mtime, and a claim that still had the chunk's
+      // creation time could be requeued as stale by another worker at once
+      utime(todo.c_str(), nullptr);
+      if (std::rename(todo.c_str(), claimed.c_str()) != 0)
+        continue;               // another worker got it first
+
+      std::ifstream ifs(claimed);
+      std::string line;
+      while (std::getline(ifs, line)) {
+        if (line.rfind(RANGE_TAG, 0) == 0)
+          std::istringstream(line.substr(strlen(RANGE_TAG))) >> c.first >> c.last;
+        else if (!line.empty())
+          c.files.push_back(line);
+      }
+
+      chunk = std::move(c);
+      return true;
+    }
+
+    // Nothing left to claim, unless some worker died
+    if (requeueStale() == 0)
+      break;
+  }
+
+  return false;
+}
+
+void WorkQueue::heartbeat(const WorkChunk& chunk)
+{
+  utime(path("claimed", claimName(chunk)).c_str(), nullptr);
+}
+
+// Moving our claim to done/ is what proves it's still ours. The manifest,
+// written beforehand, then replaces the claim's contents.
+bool WorkQueue::complete(const WorkChunk& chunk, const std::string& outputs)
+{
+  const std::string done = path("done", chunk.name);
+  const std::string tmp = path("done", "." + chunk.name + ".tmp" + std::to_string(getpid()));
+
+  {
+    std::ofstream ofs(tmp, std::ios::trunc);
+    ofs << outputs;
+    if (!ofs)
+      throw std::runtime_error(TmpStr("WorkQueue: can't write %s", tmp.c_str()));
+  }
+
+  if (std::rename(path("claimed", claimName(chunk)).c_str(), done.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+
+  if (std::rename(tmp.c_str(), done.c_str()) != 0)
+    throw std::runtime_error(TmpStr("WorkQueue: can't rename %s", tmp.c_str()));
+  return true;
+}
+
+void WorkQueue::fail(const WorkChunk& chunk, const std::string& why)
+{
+  const std::string claimed = path("claimed", claimName(chunk));
+
+  if (chunk.tries + 1 > maxRetries_) {
+    const std::string failed = path("failed", chunk.name);
+    if (std::rename(claimed.c_str(), failed.c_str()) == 0)
+      std::ofstream(failed, std::ios::app) << "#error " << why << "\n";
+  } else {
+    const std::string name = chunk.name + ".t" + std::to_string(chunk.tries + 1);
+    std::rename(claimed.c_str(), path("todo", name).c_str());
+  }
+  // If the renames failed, our claim was already requeued as stale
+}
+
+void WorkQueue::release(const WorkChunk& chunk)
+{
+  const std::string name = chunk.name + ".t" + std::to_string(chunk.tries);
+  std::rename(path("claimed", claimName(chunk)).c_str(), path("todo", name).c_str());
+}
+
+size_t WorkQueue::requeueStale()
+{
+  const time_t now = fsNow(dir_ + "/claimed");
+  size_t n = 0;
+
+  for (const auto& name : listDir(dir_ + "/claimed")) {
+    struct stat st;
+    const std::string claimed = path("claimed", name);
+    if (stat(claimed.c_str(), &st) != 0 || now - st.st_mtime < staleSeconds_)
+      continue;
+
+    WorkChunk chunk;
+    parseName(name, chunk);
+    const std::string dest = chunk.tries + 1 > maxRetries_ ?
+      path("failed", chunk.name) :
+      path("todo", chunk.name + ".t" + std::to_string(chunk.tries + 1));
+
+    if (std::rename(claimed.c_str(), dest.c_str()) == 0)
+      ++n;
+  }
+
+  return n;
+}
+
+size_t WorkQueue::count(const char* state) const
+{
+  return listDir(dir_ + "/" + state).size();
+}
+
+// -----------------------------------------------------------------------------
+
+size_t runQueue(const std::string& dir, const ChunkSetup& setup)
+{
+  WorkQueue queue(dir);
+  const auto beatPeriod = std::chrono::duration<double>(
+    std::min(MAX_HEARTBEAT_SECONDS, queue.staleSeconds() / 3));
+
+  WorkChunk chunk;
+  size_t nDone = 0;
+
+  while (queue.claim(chunk)) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool working = true;
+
+    std::thread beater([&] {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (!cv.wait_for(lock, beatPeriod, [&] { return !working; }))
+        queue.heartbeat(chunk);
+    });
+
+    std::string manifest, error, refusal;
+    std::vector<std::string> unused;
+    try {
+      Pipeline p;
+      p.setWorkerId(attemptId(chunk));
+      setup(p, chunk);
+
+      // Not the chunk's fault, and every other chunk would be refused too
+      refusal = p.slicingProblem();
+      if (refusal.empty())
+        p.process(chunk.files);
+
+      for (const auto& [requested, actual] : p.outFilePaths()) {
+        manifest += requested + "\t" + actual + "\n";
+        unused.push_back(actual);
+      }
+    } catch (const std::exception& e) { // outputs are closed either way
+      error = e.what();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      working = false;
+    }
+    cv.notify_all();
+    beater.join();
+
+    if (!refusal.empty()) {
+      for (const auto& path : unused)
+        std::remove(path.c_str());
+      queue.release(chunk);
+      throw std::runtime_error(refusal);
+    }
+
+    if (error.empty()) {
+      if (queue.complete(chunk, manifest)) {
+        ++nDone;
+      } else {
+        std::cerr << "WorkQueue: lost the claim on " << chunk.name
+                  << "; dropping its outputs" << std::endl;
+        for (const auto& path : unused)
+          std::remove(path.c_str());
+      }
+    } else {
+      std::cerr << "WorkQueue: " << chunk.name << " failed: " << error << std::endl;
+      queue.fail(chunk, error);
+    }
+  }
+
+  return nDone;
+}
+
+void runQueueForked(const std::string& dir, size_t nWorkers, const ChunkSetup& setup)
+{
+  WorkQueue queue(dir);         // create the directories before forking
+
+  std::cout.flush();
+  fflush(stdout);
+
+  std::vector<pid_t> pids;
+  for (size_t i = 0; i < nWorkers; ++i) {
+    const pid_t pid = fork();
+    if (pid < 0)
+      throw std::runtime_error("runQueueForked: fork() failed");
+
+    if (pid == 0) {
+      int status = 0;
+      try {
+        runQueue(dir, setup);
+      } catch (const std::exception& e) {
+        std::cerr << "Queue worker " << i << ": " << e.what() << std::endl;
+        status = 1;
+      }
+      fflush(stdout);
+      _exit(status);
+    }
+
+    pids.push_back(pid);
+  }
+
+  size_t nFailed = 0;
+  for (const pid_t pid : pids) {
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      ++nFailed;
+  }
+
+  if (nFailed)
+    throw std::runtime_error(TmpStr("runQueueForked: %zu of %zu workers failed",
+                                    nFailed, pids.size()));
+}
+
+void mergeQueueOutputs(const std::string& dir)
+{
+  WorkQueue queue(dir);
+
+  if (queue.count("todo") || queue.count("claimed"))
+    throw std::runtime_error(TmpStr("mergeQueueOutputs: %s still has work", dir.c_str()));
+  if (const size_t nFailed = queue.count("failed"))
+    throw std::runtime_error(TmpStr("mergeQueueOutputs: %zu chunks failed in %s",
+                                    nFailed, dir.c_str()));
+
+  // requested path -> chunk outputs, in chunk order
+  std::map<std::string, std::vector<std::string>> parts;
+
+  for (const auto& name : listDir(dir + "/done")) {
+    std::ifstream ifs(dir + "/done/" + name);
+    std::string line;
+    while (std::getline(ifs, line)) {
+      const auto tab = line.find('\t');
+      if (tab != std::string::npos)
+        parts[line.substr(0, tab)].push_back(line.substr(tab + 1));
+    }
+  }
+
+  for (const auto& [outPath, chunkPaths] : parts)
+    mergeOutputs(outPath, chunkPaths);
+}
+
+void processInputArg(const char* arg, const ChunkSetup& setup)
+{
+  if (strncmp(arg, "queue:", 6) == 0) {
+    runQueue(arg + 6, setup);
+    return;
+  }
+
+  WorkChunk all;
+  all.name = "all";
+  all.files = util::parse_infile_arg(arg);
+
+  Pipeline p;
+  setup(p, all);
+  p.process(all.files);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ChainIndex.hh"
+#include "EntryList.hh"
+#include "Kernel.hh"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// A piece of work: some input files, optionally restricted to an entry range
+// (of the chain made from those files; see SyncReader::setEntryRange).
+struct WorkChunk {
+  std::string name;             // e.g. "c00042"
+  size_t number = 0;
+  size_t tries = 0;             // previous failed attempts
+  std::vector<std::string> files;
+  size_t first = 0, last = EntryBitmap::npos;
+
+  bool hasRange() const { return first != 0 || last != EntryBitmap::npos; }
+};
+
+using ChunkSetup = std::function<void(Pipeline&, const WorkChunk&)>;
+
+// A queue of WorkChunks in a directory on a shared filesystem, so that any
+// number of worker processes, on any nodes, can pull work until it runs out:
+//
+//   <dir>/todo/c00042.t0            waiting (t<N>: N earlier failures)
+//   <dir>/claimed/c00042.t0@host.pid  being processed
+//   <dir>/done/c00042               finished; lists the chunk's outputs
+//   <dir>/failed/c00042             gave up after maxRetries
+//
+// Every transition is a rename(), which is atomic, so exactly one worker wins
+// each claim without any locking or external service. A worker keeps its
+// claim's mtime fresh while it works; claims that go stale (the worker died)
+// are put back in todo/ by whichever worker runs out of work first. Staleness
+// goes by the filesystem's clock, not the local one.
+class WorkQueue {
+public:
+  WorkQueue(const std::string& dir);
+
+  // Fill a new queue: files are grouped, in order, into chunks of about
+  // targetBytes. If treeName is given, files bigger than twice that are split
+  // into cluster-aligned entry ranges instead (found via `index` if given).
+  static WorkQueue create(const std::string& dir, const std::vector<std::string>& files,
+                          size_t targetBytes, const char* treeName = nullptr,
+                          ChainIndex* index = nullptr);
+  void addChunk(const std::vector<std::string>& files,
+                size_t first = 0, size_t last = EntryBitmap::npos);
+
+  void setMaxRetries(size_t n) { maxRetries_ = n; }
+  void setStaleSeconds(double s) { staleSeconds_ = s; }
+  double staleSeconds() const { return staleSeconds_; }
+
+  bool claim(WorkChunk& chunk);
+  void heartbeat(const WorkChunk& chunk);
+  // `outputs` is a manifest of "requested\tactual\n" output paths. False if
+  // the claim was lost (requeued as stale), in which case the chunk isn't ours
+  // to complete and the outputs should be dropped.
+  bool complete(const WorkChunk& chunk, const std::string& outputs);
+  void fail(const WorkChunk& chunk, const std::string& why);
+  void release(const WorkChunk& chunk); // back to todo/, not counted as a try
+  size_t requeueStale();
+
+  size_t count(const char* state) const; // "todo", "claimed", "done", "failed"
+  const std::string& dir() const { return dir_; }
+
+private:
+  std::string path(const char* state, const std::string& name) const;
+  std::string claimName(const WorkChunk& chunk) const;
+  void writeAtomically(const std::string& dest, const std::string& contents) const;
+
+  std::string dir_;
+  size_t maxRetries_ = 2;
+  double staleSeconds_ = 600;
+  size_t nextNumber_ = 0;
+};
+
+// Claim and process chunks until the queue is empty. Each chunk gets a fresh
+// Pipeline, set up by setup() and with a worker ID naming the attempt, so
+// outputs go to "foo.w<number>.t<tries>-<host>.<pid>.root" (see
+// Pipeline::setWorkerId): a worker that lost its claim can't clobber the
+// outputs of the one that took the chunk over. A chunk that throws is retried
+// later, possibly by another worker, starting over. A pipeline that can't be
+// split (see Pipeline::slicingProblem) makes this throw, leaving the chunk in
+// the queue. Returns the number of chunks this process completed.
+size_t runQueue(const std::string& dir, const ChunkSetup& setup);
+
+// Same, with nWorkers local processes
+void runQueueForked(const std::string& dir, size_t nWorkers, const ChunkSetup& setup);
+
+// Once the queue is drained: merge every chunk's outputs, in chunk order, into
+// the "foo.root" that a single job would have written
+void mergeQueueOutputs(const std::string& dir);
+
+// For mains taking an input argument: "queue:<dir>" makes this process a
+// queue worker; anything else goes through util::parse_infile_arg and is
+// processed as a single chunk.
+void processInputArg(const char* arg, const ChunkSetup& setup);
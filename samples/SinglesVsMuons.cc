@@ -1,9 +1,14 @@
 #include <TH1F.h>
 
-#include "../core/Kernel.cc"
-#include "../core/SeqReader.cc"
-#include "../core/RingBuf.cc"
-#include "../core/Util.cc"
+#include <cmath>
+
+#include "../core/Checkpoint.hh"
+#include "../core/Kernel.hh"
+#include "../core/RingBuf.hh"
+#include "../core/SimpleAlg.hh"
+#include "../core/SyncReader.hh"
+#include "../core/TimeHist.hh"
+#include "../core/Util.hh"
 
 using Status = Algorithm::Status;
 using namespace util;
@@ -16,28 +21,21 @@ UInt_t MUON_SEP_US = 10;        // min separation between 2 distinct muons
 
 // -----------------------------------------------------------------------------
 
-class SingReader : public SeqReader {
-public:
-  SingReader() :
-    SeqReader{"/Event/Rec/AdSimple", "/Event/Data/CalibStats"} {};
+struct SingData : public TreeBase {
+  // RecHeader
+  Short_t detector;
+  UInt_t triggerType, triggerTimeSec, triggerTimeNanoSec;
+  Float_t energy;
 
-  struct Data {
-    // RecHeader
-    Short_t detector;
-    UInt_t triggerType, triggerTimeSec, triggerTimeNanoSec;
-    Float_t energy;
+  // CalibStats
+  Int_t nHit;
+  Float_t NominalCharge;
+  Float_t Quadrant, MaxQ, MaxQ_2inchPMT, time_PSD, time_PSD1;
 
-    // CalibStats
-    Int_t nHit;
-    Float_t NominalCharge;
-    Float_t Quadrant, MaxQ, MaxQ_2inchPMT, time_PSD, time_PSD1;
-  } data;
-
-private:
   void initBranches() override;
 };
 
-void SingReader::initBranches()
+void SingData::initBranches()
 {
   BR(detector);
   BR(triggerType); BR(triggerTimeSec); BR(triggerTimeNanoSec);
@@ -47,6 +45,12 @@ void SingReader::initBranches()
   BR(Quadrant); BR(MaxQ); BR(MaxQ_2inchPMT); BR(time_PSD); BR(time_PSD1);
 }
 
+class SingReader : public SyncReader<SingData> {
+public:
+  SingReader() :
+    SyncReader<SingData>({"/Event/Rec/AdSimple", "/Event/Data/CalibStats"}) {};
+};
+
 // -----------------------------------------------------------------------------
 
 Status crossTriggerAlg(const SingReader::Data& e)
@@ -80,18 +84,22 @@ class MuonAlg : public SimpleAlg<SingReader> {
 public:
   MuonAlg() : muons(N_MUONS) {}
 
-  Status execute() override;
+  Status consume(const SingData& e) override;
+
+  void saveState(StateWriter& w) const override { w.put(muons); }
+  void loadState(StateReader& r) override { r.get(muons); }
+  bool carriesState() const override { return true; }
 
   RingBuf<Time> muons;
 
 private:
-  bool isMuon();
+  bool isMuon(const SingData& e);
 };
 
-Status MuonAlg::execute()
+Status MuonAlg::consume(const SingData& e)
 {
-  if (isMuon()) {
-    const Time t(data->triggerTimeSec, data->triggerTimeNanoSec);
+  if (isMuon(e)) {
+    const Time t(e.triggerTimeSec, e.triggerTimeNanoSec);
     const float sep = t.diff_us(muons.top());
     if (sep > MUON_SEP_US) {
       muons.put(t);
@@ -102,15 +110,15 @@ Status MuonAlg::execute()
   return Status::Continue;
 }
 
-bool MuonAlg::isMuon()
+bool MuonAlg::isMuon(const SingData& e)
 {
-  if (data->detector == 7)
+  if (e.detector == 7)
     return false;                    // ignore RPC
 
-  if (data->detector == 5 || data->detector == 6)
-    return data->nHit > 12;          // WP muon
+  if (e.detector == 5 || e.detector == 6)
+    return e.nHit > 12;              // WP muon
 
-  return data->NominalCharge > 3000; // AD muon
+  return e.NominalCharge > 3000;     // AD muon
 }
 
 // -----------------------------------------------------------------------------
@@ -121,7 +129,10 @@ public:
 
   void connect(Pipeline& pipeline) override;
   Status execute() override;
-  void finalize(Pipeline& pipeline) override;
+
+  void saveState(StateWriter& w) const override;
+  void loadState(StateReader& r) override;
+  bool carriesState() const override { return true; }
 
 private:
   bool isPmp();
@@ -158,17 +169,29 @@ TH1F SinglesVsMuonsAlg::newHist(const char* name, const char* title)
 
 void SinglesVsMuonsAlg::connect(Pipeline& pipeline)
 {
-  data = &pipeline.getAlg<SingReader>().data;
-  muons = &pipeline.getAlg<MuonAlg>().muons;
+  data = &pipeline.getAlg<SingReader>()->data;
+  muons = &pipeline.getAlg<MuonAlg>()->muons;
+
+  // written (and merged, in parallel modes) by the framework
+  for (TH1F* h : {&hDlyAll, &hDlyLoose, &hDlyTight})
+    pipeline.results().addHist(h, outFileName.c_str());
 }
 
-void SinglesVsMuonsAlg::finalize(Pipeline& pipeline)
+// The histograms are registered results, so the checkpoint saves them
+void SinglesVsMuonsAlg::saveState(StateWriter& w) const
 {
-  pipeline.getOutFile(outFileName)->cd();
+  w.put(lastPmpTime);
+  w.put(lastDlyTime);
+  w.put(gapToDlyBeforeLastDly);
+  w.put(gapToPmpBeforeLastDly);
+}
 
-  hDlyAll.Write();
-  hDlyLoose.Write();
-  hDlyTight.Write();
+void SinglesVsMuonsAlg::loadState(StateReader& r)
+{
+  r.get(lastPmpTime);
+  r.get(lastDlyTime);
+  r.get(gapToDlyBeforeLastDly);
+  r.get(gapToPmpBeforeLastDly);
 }
 
 bool SinglesVsMuonsAlg::isPmp()
@@ -183,10 +206,7 @@ bool SinglesVsMuonsAlg::isDly()
 
 void SinglesVsMuonsAlg::fill(TH1F& h, Time t)
 {
-  for (const auto& muonTime : *muons) {
-    const float dt_us = t.diff_us(muonTime);
-    h.Fill(dt_us);
-  }
+  fillTimeDiffs(h, t, *muons);
 }
 
 Status SinglesVsMuonsAlg::execute()
@@ -223,11 +243,15 @@ Status SinglesVsMuonsAlg::execute()
   return Status::Continue;
 }
 
-void run(const std::vector<std::string>& files, int maxEvents=0)
+void run(const std::vector<std::string>& files, int maxEvents=0,
+         const char* outPath="results.root", const char* checkpointPath=nullptr)
 {
   Pipeline p;
 
-  p.addOutFile("resultsFile", "results.root");
+  if (checkpointPath)
+    p.enableCheckpoints(checkpointPath);
+
+  p.makeOutFile(outPath, "resultsFile");
 
   p.makeAlg<SingReader>().setMaxEvents(maxEvents);
   p.makeAlg<CrossTriggerAlg>();
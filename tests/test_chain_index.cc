@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../core/ChainIndex.cc"
+
+namespace {
+
+bool expect(const char* what, bool ok)
+{
+  std::cout << what << ": " << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+// Stands in for an input file; only its size and mtime matter here
+void writeFile(const std::string& path, const std::string& contents)
+{
+  std::ofstream(path, std::ios::trunc) << contents;
+}
+
+FileIndex made(const std::string& file, size_t entries)
+{
+  FileIndex idx;
+  ChainIndex::stamp(file, idx);
+  idx.entries = entries;
+  for (size_t c = 0; c < entries; c += 1000)
+    idx.clusters.push_back(c);
+  idx.firstTime = Time(1600000000, 123456789);
+  idx.lastTime = Time(1600003600, 987654321);
+  return idx;
+}
+
+bool same(const FileIndex* a, const FileIndex& b)
+{
+  return a && a->size == b.size && a->mtime == b.mtime && a->entries == b.entries &&
+    a->clusters == b.clusters && a->firstTime == b.firstTime && a->lastTime == b.lastTime;
+}
+
+} // namespace
+
+// Entries survive save() and a fresh read, two indexes saving over each other
+// keep both their entries, and a modified file is no longer trusted
+void test_chain_index()
+{
+  char dirTemplate[] = "/tmp/test_chain_index.XXXXXX";
+  const std::string dir = mkdtemp(dirTemplate);
+  const std::string path = dir + "/index.txt";
+  const std::string a = dir + "/a.root", b = dir + "/b with space.root";
+  writeFile(a, "aaaa");
+  writeFile(b, "bbbbbbbb");
+
+  const FileIndex ia = made(a, 2500), ib = made(b, 0);
+  {
+    ChainIndex first(path), second(path); // both read the (missing) index
+    first.put(a, "events", ia);
+    second.put(b, "muons", ib);
+    first.save();
+    second.save();
+  }
+
+  ChainIndex index(path);
+  expect("round trip", same(index.find(a, "events"), ia));
+  expect("other job's entry kept", same(index.find(b, "muons"), ib));
+  expect("unknown tree", index.find(a, "muons") == nullptr);
+
+  // Same size, newer mtime: only the ns stamp may tell them apart
+  writeFile(a, "AAAA");
+  expect("modified file", index.find(a, "events") == nullptr);
+
+  const std::string rm = "rm -r '" + dir + "'";
+  std::system(rm.c_str());
+}
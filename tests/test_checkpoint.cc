@@ -0,0 +1,204 @@
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "../core/Kernel.cc"
+#include "../core/Checkpoint.cc"
+#include "../core/Results.cc"
+#include "../core/SimpleAlg.hh"
+#include "../core/SyncReader.hh"
+#include "../core/TreeWriter.hh"
+
+#include <TH1D.h>
+
+namespace {
+
+struct CkptData : public TreeBase {
+  int x;
+  long sum;
+
+  void initBranches() override
+  {
+    BR(x);
+    BR(sum);
+  }
+};
+
+using CkptReader = SyncReader<CkptData>;
+
+constexpr int N_EVENTS = 1000;
+
+void writeInput(const char* path)
+{
+  Pipeline p;
+  p.makeOutFile(path);
+
+  TreeWriter<CkptData> w("events");
+  w.connect(p);
+  for (int i = 0; i < N_EVENTS; ++i) {
+    w.data.x = (37 * i) % 101;
+    w.data.sum = 0;
+    w.fill();
+  }
+}
+
+// Keeps a running sum over all events, so a resumed run that forgot it (or
+// replayed or skipped events) writes different sums. Fills a registered
+// result, a histogram in a subdirectory of the output file, and a tree.
+class RunningSum : public SimpleAlg<CkptReader> {
+public:
+  void connect(Pipeline& pipeline) override
+  {
+    SimpleAlg::connect(pipeline);
+
+    xs_ = new TH1D("xs", "", 101, 0, 101);
+    xs_->SetDirectory(nullptr);
+    pipeline.results().addHist(xs_);
+
+    TFile* f = pipeline.getOutFile();
+    sub_ = f->GetDirectory("sub");
+    if (!sub_)
+      sub_ = f->mkdir("sub");
+    sub_->cd();
+    sums_ = new TH1D("sums", "", 50, 0, 50 * N_EVENTS);
+
+    writer_.connect(pipeline);
+  }
+
+  Algorithm::Status consume(const CkptData& data) override
+  {
+    sum_ += data.x;
+    xs_->Fill(data.x);
+    sums_->Fill(sum_);
+
+    writer_.data.x = data.x;
+    writer_.data.sum = sum_;
+    writer_.fill();
+    return Algorithm::Status::Continue;
+  }
+
+  void finalize(Pipeline& pipeline) override
+  {
+    sub_->WriteTObject(sums_, nullptr, "Overwrite");
+  }
+
+  bool carriesState() const override { return true; }
+  void saveState(StateWriter& w) const override { w.put(sum_); }
+  void loadState(StateReader& r) override { r.get(sum_); }
+
+private:
+  long sum_ = 0;
+  TH1D* xs_ = nullptr;
+  TH1D* sums_ = nullptr;
+  TDirectory* sub_ = nullptr;
+  TreeWriter<CkptData> writer_{"summed"};
+};
+
+// Stands in for a preemption
+struct Interrupt : Algorithm {
+  Interrupt(size_t afterCycles) : left_(afterCycles) {}
+
+  Algorithm::Status execute() override
+  {
+    if (left_-- == 0)
+      throw std::runtime_error("interrupted");
+    return Algorithm::Status::Continue;
+  }
+
+  size_t left_;
+};
+
+void run(const char* inPath, const char* outPath, const char* ckptPath, size_t interruptAfter)
+{
+  Pipeline p;
+  if (ckptPath)
+    p.enableCheckpoints(ckptPath, 64);
+  p.makeOutFile(outPath);
+
+  p.makeAlg<CkptReader>(std::initializer_list<const char*>{"events"});
+  p.makeAlg<RunningSum>();
+  if (interruptAfter)
+    p.makeAlg<Interrupt>(interruptAfter);
+
+  p.process({inPath});
+}
+
+bool sameHist(TFile& a, TFile& b, const char* name)
+{
+  TH1* ha = nullptr;
+  TH1* hb = nullptr;
+  a.GetObject(name, ha);
+  b.GetObject(name, hb);
+  if (!ha || !hb) {
+    std::cout << "  " << name << " is missing" << std::endl;
+    return false;
+  }
+
+  bool same = ha->GetEntries() == hb->GetEntries();
+  for (int i = 0; i <= ha->GetNbinsX() + 1; ++i)
+    same &= ha->GetBinContent(i) == hb->GetBinContent(i);
+  if (!same)
+    std::cout << "  " << name << " differs" << std::endl;
+  return same;
+}
+
+bool sameTree(TFile& a, TFile& b, const char* name)
+{
+  TTree* ta = nullptr;
+  TTree* tb = nullptr;
+  a.GetObject(name, ta);
+  b.GetObject(name, tb);
+  if (!ta || !tb || ta->GetEntries() != tb->GetEntries()) {
+    std::cout << "  " << name << " is missing or has a different length" << std::endl;
+    return false;
+  }
+
+  int xa, xb;
+  long sa, sb;
+  ta->SetBranchAddress("x", &xa);
+  ta->SetBranchAddress("sum", &sa);
+  tb->SetBranchAddress("x", &xb);
+  tb->SetBranchAddress("sum", &sb);
+  for (Long64_t i = 0; i < ta->GetEntries(); ++i) {
+    ta->GetEntry(i);
+    tb->GetEntry(i);
+    if (xa != xb || sa != sb) {
+      std::cout << "  " << name << " differs at entry " << i << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+// Interrupts a checkpointed job between checkpoints (so that the outputs hold
+// events past the last one), resumes it, and compares with a job that ran
+// straight through
+void test_checkpoint()
+{
+  writeInput("ckpt_in.root");
+  std::remove("ckpt_out.ckpt");
+
+  run("ckpt_in.root", "ckpt_ref.root", nullptr, 0);
+
+  try {
+    run("ckpt_in.root", "ckpt_out.root", "ckpt_out.ckpt", 300);
+    std::cout << "not interrupted: FAILED" << std::endl;
+  } catch (const std::runtime_error& e) {
+    std::cout << "interrupted after 300 cycles" << std::endl;
+  }
+
+  run("ckpt_in.root", "ckpt_out.root", "ckpt_out.ckpt", 0);
+
+  TFile ref("ckpt_ref.root");
+  TFile out("ckpt_out.root");
+  bool ok = sameHist(ref, out, "xs");
+  ok &= sameHist(ref, out, "sub/sums");
+  ok &= sameTree(ref, out, "summed");
+  std::cout << "resumed run: " << (ok ? "ok" : "FAILED") << std::endl;
+
+  const bool removed = std::remove("ckpt_out.ckpt") != 0;
+  std::cout << "checkpoint removed when done: " << (removed ? "ok" : "FAILED") << std::endl;
+}
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "../core/Coincidence.hh"
+
+namespace {
+
+struct Ev {
+  Time t;
+  bool prompt, delayed;
+};
+
+using Pairs = std::vector<std::pair<size_t, size_t>>;
+
+// Straight from the definition in Coincidence.hh, checking every candidate
+// pair against every other event
+Pairs bruteForce(const std::vector<Ev>& evs, const CoincidenceWindow& w)
+{
+  const auto ns = [](double us) { return std::llround(1e3 * us); };
+  const int64_t dtMin = ns(w.dtMin_us), dtMax = ns(w.dtMax_us);
+  const int64_t pre = ns(w.preIsolation_us), post = ns(w.postIsolation_us);
+
+  Pairs pairs;
+  for (size_t d = 0; d < evs.size(); ++d) {
+    if (!evs[d].delayed)
+      continue;
+    const int64_t td = evs[d].t.nanos;
+
+    for (size_t p = 0; p < d; ++p) {
+      const int64_t tp = evs[p].t.nanos;
+      if (!evs[p].prompt || td - tp < dtMin || td - tp > dtMax)
+        continue;
+
+      bool isolated = true;
+      for (size_t o = 0; o < evs.size() && isolated; ++o) {
+        if (o == p || o == d)
+          continue;
+        const int64_t to = evs[o].t.nanos;
+        if (evs[o].prompt && ((to >= tp - pre && to < td) || (to >= td - dtMax && to < td)))
+          isolated = false;
+        if (evs[o].delayed && to > tp && to <= td + post)
+          isolated = false;
+      }
+
+      if (isolated)
+        pairs.emplace_back(p, d);
+    }
+  }
+
+  return pairs;
+}
+
+Pairs streaming(const std::vector<Ev>& evs, const CoincidenceWindow& w)
+{
+  Pairs pairs;
+  CoincidenceFinder<size_t> finder(w, [&](size_t p, size_t d) { pairs.emplace_back(p, d); });
+  for (size_t i = 0; i < evs.size(); ++i)
+    finder.add(evs[i].t, i, evs[i].prompt, evs[i].delayed);
+  finder.flush();
+  return pairs;
+}
+
+} // namespace
+
+// Random streams, dense enough that the isolation cuts matter, compared for
+// several windows
+void test_coincidence()
+{
+  const CoincidenceWindow windows[] = {
+    {1, 200, 0, 0},
+    {1, 200, 400, 200},
+    {0.5, 50, 100, 1000},
+    {10, 20, 0, 0},
+  };
+
+  std::mt19937_64 rng(42);
+  std::exponential_distribution<double> gap_us(1 / 60.);
+  std::uniform_real_distribution<double> u01;
+
+  for (const auto& w : windows) {
+    std::vector<Ev> evs;
+    Time t(1000, 0);
+    for (size_t i = 0; i < 20000; ++i) {
+      t = t.shifted_ns(1 + std::llround(1e3 * gap_us(rng)));
+      const double r = u01(rng);
+      evs.push_back({t, r < 0.2, r > 0.15 && r < 0.35}); // some are both
+    }
+
+    const Pairs expected = bruteForce(evs, w);
+    const Pairs actual = streaming(evs, w);
+
+    std::cout << "dt [" << w.dtMin_us << ", " << w.dtMax_us << "] pre " << w.preIsolation_us
+              << " post " << w.postIsolation_us << ": " << expected.size() << " pairs, "
+              << (actual == expected ? "ok" : "FAILED") << std::endl;
+  }
+}
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../core/Kernel.cc"
+#include "../core/Checkpoint.cc"
+#include "../core/EntryList.cc"
+
+namespace {
+
+// Same size and same bits, checked through test() and next()
+bool sameBits(const EntryBitmap& a, const std::vector<bool>& expected)
+{
+  if (a.size() != expected.size())
+    return false;
+
+  size_t nextSet = a.next(0);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (a.test(i) != expected[i])
+      return false;
+    if (expected[i]) {
+      if (nextSet != i)
+        return false;
+      nextSet = a.next(i + 1);
+    }
+  }
+  return nextSet == EntryBitmap::npos;
+}
+
+EntryBitmap randomBitmap(size_t n, double density, std::vector<bool>& bits)
+{
+  static std::mt19937_64 rng(3);
+  std::bernoulli_distribution pick(density);
+
+  EntryBitmap bitmap(n);
+  bits.assign(n, false);
+  for (size_t i = 0; i < n; ++i)
+    if (pick(rng)) {
+      bitmap.set(i);
+      bits[i] = true;
+    }
+  return bitmap;
+}
+
+// count(first, last) against the bits, for every range with ends near word
+// boundaries (and past the end)
+bool checkCounts(const EntryBitmap& bitmap, const std::vector<bool>& bits)
+{
+  std::vector<size_t> ends;
+  for (size_t b = 0; b <= bits.size() + 64; b += 64)
+    for (const size_t d : {0, 1, 2, 31, 62, 63})
+      ends.push_back(b + d);
+
+  for (const size_t first : ends)
+    for (const size_t last : ends) {
+      size_t expected = 0;
+      for (size_t i = first; i < std::min(last, bits.size()); ++i)
+        expected += bits[i];
+      if (bitmap.count(first, last) != expected) {
+        std::cout << "  count(" << first << ", " << last << ") = "
+                  << bitmap.count(first, last) << ", expected " << expected << std::endl;
+        return false;
+      }
+    }
+  return true;
+}
+
+} // namespace
+
+// Round trips through a file and through a checkpoint, and range counts, for
+// sizes on and around word boundaries
+void test_entry_bitmap()
+{
+  const char* path = "test_entry_bitmap.bin";
+
+  for (const size_t n : {0, 1, 63, 64, 65, 1000}) {
+    std::vector<bool> bits;
+    const EntryBitmap bitmap = randomBitmap(n, 0.1, bits);
+
+    bitmap.save(path);
+    const EntryBitmap loaded = EntryBitmap::load(path);
+
+    StateWriter w;
+    bitmap.saveState(w);
+    StateReader r(w.bytes().data(), w.bytes().size(), "bitmap");
+    EntryBitmap restored(5);
+    restored.loadState(r);
+
+    const bool fileOk = sameBits(loaded, bits);
+    const bool stateOk = sameBits(restored, bits) && r.atEnd();
+    const bool countOk = checkCounts(bitmap, bits);
+    std::cout << n << " entries, " << bitmap.count() << " selected: "
+              << (fileOk && stateOk && countOk ? "ok" : "FAILED")
+              << (fileOk ? "" : " (save/load)") << (stateOk ? "" : " (saveState/loadState)")
+              << (countOk ? "" : " (count)") << std::endl;
+  }
+
+  // Not a bitmap, and a truncated one
+  {
+    FILE* f = fopen(path, "w");
+    fputs("not a bitmap at all", f);
+    fclose(f);
+  }
+  bool threw = false;
+  try {
+    EntryBitmap::load(path);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  std::cout << "bad magic: " << (threw ? "ok" : "FAILED") << std::endl;
+
+  EntryBitmap(1000).save(path);
+  truncate(path, 100);
+  threw = false;
+  try {
+    EntryBitmap::load(path);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  std::cout << "truncated: " << (threw ? "ok" : "FAILED") << std::endl;
+
+  std::remove(path);
+}
@@ -3,6 +3,7 @@
 #include "../core/Kernel.cc"
 #include "../core/TreeWriter.cc"
 #include "../core/SyncReader.cc"
+#include "../core/DirectReader.hh"
 
 struct MyData : public TreeBase {
   int x;
@@ -76,3 +77,15 @@ void test_read()
 
   p.process({"out_test.root"});
 }
+
+void test_snapshot()
+{
+  TFile f("out_test.root");
+  DirectReader<MyData> r(&f, "foo_AD1");
+
+  std::cout << "snapshot needs " << r.snapshotBytes() << " bytes" << std::endl;
+  r.snapshot();
+
+  for (size_t i = 0; i < r.size(); ++i)
+    readerTestAlg(r.at(i));
+}
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <vector>
+
+#include "../core/Strings.hh"
+#include "../core/TimeHist.cc"
+
+#include <TH1D.h>
+
+// Bins, entries and stats must match exactly. Prints any difference.
+static bool sameFills(TH1& expected, TH1& actual)
+{
+  bool same = expected.GetEntries() == actual.GetEntries();
+  for (int b = 0; b <= expected.GetNbinsX() + 1; ++b) {
+    if (expected.GetBinContent(b) != actual.GetBinContent(b)) {
+      std::cout << "  bin " << b << ": Fill " << expected.GetBinContent(b)
+                << ", fillTimeDiffs " << actual.GetBinContent(b) << std::endl;
+      same = false;
+    }
+  }
+
+  double s1[TH1::kNstat] = {}, s2[TH1::kNstat] = {};
+  expected.GetStats(s1);
+  actual.GetStats(s2);
+  for (int i = 0; i < 4; ++i) {
+    if (s1[i] != s2[i]) {
+      std::cout << "  stat " << i << ": Fill " << s1[i]
+                << ", fillTimeDiffs " << s2[i] << std::endl;
+      same = false;
+    }
+  }
+
+  return same;
+}
+
+// Fill `expected` with Fill() and `actual` with fillTimeDiffs, using time
+// differences of every ns in [fromNs, toNs), so that every bin edge that
+// falls on a whole ns gets hit exactly
+static bool compareFills(TH1& expected, TH1& actual, int64_t fromNs, int64_t toNs)
+{
+  const Time t = Time::fromNanos(1'000'000'000'000);
+  std::vector<Time> times;
+  for (int64_t d = fromNs; d < toNs; ++d)
+    times.push_back(t.shifted_ns(-d));
+
+  for (const Time& other : times)
+    expected.Fill(t.diff_us(other));
+  fillTimeDiffs(actual, t, times.data(), times.size());
+
+  return sameFills(expected, actual);
+}
+
+static void report(const char* what, bool same)
+{
+  std::cout << what << ": " << (same ? "same as Fill" : "MISMATCH") << std::endl;
+}
+
+void test_timehist()
+{
+  struct Axis {
+    int nbins;
+    double xmin, xmax;          // us
+  };
+
+  // Edges on whole ns, most of them not exactly representable as doubles
+  const Axis axes[] = {
+    {30, -0.3, 2.7},
+    {7, 0.1, 0.8},
+    {1000, 0, 3},
+    {3, -1.2, 0.9},
+  };
+
+  for (const auto& a : axes) {
+    TH1D expected("expected", "", a.nbins, a.xmin, a.xmax);
+    TH1D actual("actual", "", a.nbins, a.xmin, a.xmax);
+    const auto fromNs = int64_t(1e3 * a.xmin) - 50, toNs = int64_t(1e3 * a.xmax) + 50;
+    report(TmpStr("%d bins in [%g, %g]", a.nbins, a.xmin, a.xmax),
+           compareFills(expected, actual, fromNs, toNs));
+  }
+
+  // On top of earlier entries, from a ring that has wrapped (two segments)
+  {
+    TH1D expected("expected", "", 40, -0.3, 2.7);
+    TH1D actual("actual", "", 40, -0.3, 2.7);
+    for (const double x : {0.1234567, 1.7654321, 2.5}) {
+      expected.Fill(x);
+      actual.Fill(x);
+    }
+
+    const Time t = Time::fromNanos(1'000'000'000'000);
+    RingBuf<Time> ring(1000);
+    for (int64_t d = 2999; d >= -400; --d)
+      ring.put(t.shifted_ns(-d));
+    ring.forEachSegment([&](const Time* ptr, size_t n) {
+      for (size_t i = 0; i < n; ++i)
+        expected.Fill(t.diff_us(ptr[i]));
+    });
+    fillTimeDiffs(actual, t, ring);
+    report("earlier entries, wrapped ring", sameFills(expected, actual));
+  }
+
+  // Cases that must go through Fill()
+  {
+    TH1D expected("expected", "", 10, 0, 1);
+    TH1D actual("actual", "", 10, 0, 1);
+    expected.SetCanExtend(TH1::kXaxis);
+    actual.SetCanExtend(TH1::kXaxis);
+    report("extendable axis", compareFills(expected, actual, -200, 1500));
+  }
+  {
+    TH1D expected("expected", "", 10, 0, 1);
+    TH1D actual("actual", "", 10, 0, 1);
+    expected.GetXaxis()->SetRange(3, 6);
+    actual.GetXaxis()->SetRange(3, 6);
+    report("user range", compareFills(expected, actual, -200, 1500));
+  }
+  {
+    TH1D expected("expected", "", 10, 0, 1);
+    TH1D actual("actual", "", 10, 0, 1);
+    expected.SetStatOverflows(TH1::kConsider);
+    actual.SetStatOverflows(TH1::kConsider);
+    report("StatOverflows", compareFills(expected, actual, -200, 1500));
+  }
+}
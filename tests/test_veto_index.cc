@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../core/Kernel.cc"
+#include "../core/VetoIndex.cc"
+
+namespace {
+
+struct Muon {
+  int64_t t;                    // ns
+  float energy;
+};
+
+using Steps = std::vector<std::pair<float, double>>;
+
+// The veto of each muon on its own, without any merging
+std::vector<std::pair<int64_t, int64_t>> windows(const std::vector<Muon>& muons,
+                                                 const Steps& steps)
+{
+  std::vector<std::pair<int64_t, int64_t>> result;
+  for (const auto& mu : muons) {
+    double veto_us = -1;
+    for (const auto& [minEnergy, v] : steps)
+      if (mu.energy >= minEnergy)
+        veto_us = v;
+    if (veto_us >= 0)
+      result.emplace_back(mu.t, mu.t + std::llround(1e3 * veto_us));
+  }
+  return result;
+}
+
+// Length of the union of the windows, up to `until`, one ns at a time
+int64_t vetoedUntil(const std::vector<std::pair<int64_t, int64_t>>& wins, int64_t until)
+{
+  int64_t n = 0;
+  for (int64_t t = 0; t < until; ++t)
+    for (const auto& [start, end] : wins)
+      if (start <= t && t < end) {
+        ++n;
+        break;
+      }
+  return n;
+}
+
+bool check(const char* what, const std::vector<Muon>& muons, const Steps& steps,
+           int64_t queryStep)
+{
+  VetoIndex veto;
+  veto.setVeto(0, steps);
+  for (const auto& mu : muons)
+    veto.addMuon(0, Time::fromNanos(mu.t), mu.energy);
+
+  const auto wins = windows(muons, steps);
+  const int64_t last = muons.back().t + 3000;
+  bool ok = true;
+
+  for (int64_t t = 0; t <= last && ok; t += queryStep) {
+    bool expected = false;
+    for (const auto& [start, end] : wins)
+      expected |= start <= t && t <= end;
+
+    if (veto.isVetoed(0, Time::fromNanos(t)) != expected) {
+      std::cout << "  isVetoed(" << t << ") is wrong" << std::endl;
+      ok = false;
+    }
+
+    const int64_t vetoed = std::llround(1e9 * veto.vetoedTime_s(0));
+    if (t % 997 == 0 && vetoed != vetoedUntil(wins, t)) {
+      std::cout << "  vetoedTime_s at " << t << ": " << vetoed << " ns, expected "
+                << vetoedUntil(wins, t) << std::endl;
+      ok = false;
+    }
+  }
+
+  std::cout << what << ": " << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+} // namespace
+
+void test_veto_index()
+{
+  const Steps steps = {{0, 1}, {100, 2}, {1000, 5}};
+
+  // Each kind of overlap on its own: chained, nested, touching, disjoint,
+  // and a muon below every step that must not veto anything
+  check("chained", {{1000, 0}, {1500, 0}, {2200, 0}}, steps, 1);
+  check("nested", {{1000, 1000}, {2000, 0}, {3000, 100}}, steps, 1);
+  check("touching", {{1000, 0}, {2000, 0}, {3000, 0}}, steps, 1);
+  check("disjoint", {{1000, 0}, {5000, 100}}, steps, 1);
+  check("below threshold", {{1000, 0}, {1500, -1}, {4000, 0}}, steps, 1);
+
+  // Many muons, queried more sparsely
+  std::mt19937_64 rng(7);
+  std::exponential_distribution<double> gap_ns(1 / 1500.);
+  std::uniform_real_distribution<float> energy(-50, 1500);
+
+  std::vector<Muon> muons;
+  int64_t t = 0;
+  for (int i = 0; i < 300; ++i) {
+    t += 1 + std::llround(gap_ns(rng));
+    muons.push_back({t, energy(rng)});
+  }
+  check("random", muons, steps, 7);
+
+  // Muons far ahead of the queries don't count yet
+  VetoIndex ahead;
+  ahead.setVeto(0, steps);
+  ahead.addMuon(0, Time::fromNanos(1000), 0);
+  ahead.addMuon(0, Time::fromNanos(1'000'000), 2000);
+  ahead.isVetoed(0, Time::fromNanos(1500));
+  const int64_t vetoed = std::llround(1e9 * ahead.vetoedTime_s(0));
+  std::cout << "muons ahead of queries: " << (vetoed == 500 ? "ok" : "FAILED") << std::endl;
+}
@@ -0,0 +1,110 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "../core/Kernel.cc"
+#include "../core/WorkQueue.cc"
+
+namespace {
+
+bool expect(const char* what, bool ok)
+{
+  std::cout << what << ": " << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+bool counts(const WorkQueue& q, size_t todo, size_t claimed, size_t done, size_t failed)
+{
+  return q.count("todo") == todo && q.count("claimed") == claimed &&
+    q.count("done") == done && q.count("failed") == failed;
+}
+
+} // namespace
+
+// One process playing every worker: claims, retries, releases, stale and lost
+// claims, and chunk numbers past the width of the names
+void test_work_queue()
+{
+  char dirTemplate[] = "/tmp/test_work_queue.XXXXXX";
+  const std::string dir = mkdtemp(dirTemplate);
+
+  WorkQueue q(dir);
+  q.addChunk({"a.root", "b.root"});
+  q.addChunk({"c.root"}, 100, 200);
+  expect("added", counts(q, 2, 0, 0, 0));
+
+  // Each chunk is claimed exactly once, with its files and range
+  WorkChunk c1, c2, c3;
+  const bool claimed = q.claim(c1) && q.claim(c2) && !q.claim(c3);
+  expect("claim each chunk once", claimed && counts(q, 0, 2, 0, 0));
+
+  WorkChunk& ab = c1.number == 0 ? c1 : c2;
+  WorkChunk& c = c1.number == 0 ? c2 : c1;
+  expect("files and range",
+         ab.files == std::vector<std::string>{"a.root", "b.root"} && !ab.hasRange() &&
+         c.files == std::vector<std::string>{"c.root"} && c.first == 100 && c.last == 200);
+
+  q.complete(ab, "out.root\tout.w0.root\n");
+  std::string manifest;
+  std::getline(std::ifstream(dir + "/done/" + ab.name), manifest);
+  expect("complete", counts(q, 0, 1, 1, 0) && manifest == "out.root\tout.w0.root");
+
+  // Failures come back with one more try, until maxRetries
+  q.setMaxRetries(1);
+  q.fail(c, "boom");
+  WorkChunk retry;
+  const bool retried = q.claim(retry) && retry.number == c.number && retry.tries == 1;
+  q.fail(retry, "boom again");
+  expect("retry, then give up", retried && counts(q, 0, 0, 1, 1));
+
+  // Released chunks don't count as a try
+  q.addChunk({"d.root"});
+  WorkChunk d, released;
+  q.claim(d);
+  q.release(d);
+  expect("release", q.claim(released) && released.number == d.number && released.tries == 0);
+
+  // A claim whose worker stopped beating goes back to todo/ as a try
+  q.setMaxRetries(2);
+  q.setStaleSeconds(0);
+  WorkChunk requeued;
+  const bool stale = q.requeueStale() == 1 && q.claim(requeued) &&
+    requeued.number == d.number && requeued.tries == 1;
+  q.setStaleSeconds(600);
+  expect("stale claim", stale && q.requeueStale() == 0);
+  q.complete(requeued, "");
+
+  // A chunk created long ago isn't stale the moment it's claimed
+  q.addChunk({"old.root"});
+  for (const auto& name : listDir(dir + "/todo")) {
+    const utimbuf longAgo = {0, 0};
+    utime((dir + "/todo/" + name).c_str(), &longAgo);
+  }
+  WorkChunk old;
+  expect("fresh claim of an old chunk", q.claim(old) && q.requeueStale() == 0);
+
+  // Once requeued, the claim can't be completed by its old holder
+  q.setStaleSeconds(0);
+  q.requeueStale();
+  q.setStaleSeconds(600);
+  const size_t nDone = q.count("done");
+  expect("lost claim", !q.complete(old, "x\ty\n") && q.count("done") == nDone);
+  WorkChunk retaken;
+  q.claim(retaken);
+  expect("taken over", q.complete(retaken, "") && q.count("done") == nDone + 1);
+
+  // Numbering continues from what's in the directory, past 99999
+  std::ofstream(dir + "/todo/c99999.t0") << "e.root\n";
+  WorkQueue q2(dir);
+  q2.addChunk({"f.root"});
+  WorkChunk e, f;
+  const bool wide = q2.claim(e) && q2.claim(f);
+  std::set<size_t> numbers = {e.number, f.number};
+  expect("numbers past 99999", wide && numbers == std::set<size_t>{99999, 100000});
+
+  const std::string rm = "rm -r " + dir;
+  std::system(rm.c_str());
+}